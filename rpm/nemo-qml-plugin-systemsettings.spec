@@ -1,6 +1,6 @@
 Name:       nemo-qml-plugin-systemsettings
 Summary:    System settings plugin for Nemo Mobile
-Version:    0.10.14
+Version:    1.0.0
 Release:    1
 License:    BSD
 URL:        https://github.com/sailfishos/nemo-qml-plugin-systemsettings/
@@ -17,6 +17,8 @@ Requires:       mlite-qt5 >= 0.3.6
 Requires(post): coreutils
 BuildRequires:  pkgconfig(Qt5Qml)
 BuildRequires:  pkgconfig(Qt5Network)
+BuildRequires:  pkgconfig(Qt5Concurrent)
+BuildRequires:  pkgconfig(Qt5Test)
 BuildRequires:  pkgconfig(timed-qt5)
 BuildRequires:  pkgconfig(profile)
 BuildRequires:  pkgconfig(mce) >= 1.32.0
@@ -47,6 +49,13 @@ Requires:   %{name} = %{version}-%{release}
 %description devel
 %{summary}.
 
+%package tests
+Summary:    Tests and benchmarks for %{name}
+Requires:   %{name} = %{version}-%{release}
+
+%description tests
+%{summary}.
+
 %package ts-devel
 Summary: Translation source for %{name}
 
@@ -85,5 +94,8 @@ Summary: Translation source for %{name}
 %{_includedir}/systemsettings/*
 %{_libdir}/libsystemsettings.so
 
+%files tests
+/opt/tests/nemo-qml-plugin-systemsettings/*
+
 %files ts-devel
 %{_datadir}/translations/source/*.ts
@@ -30,11 +30,30 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
  */
 
-#include "certificatemodel.h"
-
+#include "certificatemodel_p.h"
+#include "logging_p.h"
+
+#include <QCache>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEvent>
 #include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
 #include <QRegularExpression>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
 #include <QDebug>
+#include <algorithm>
 #include <functional>
 
 #include <openssl/opensslv.h>
@@ -46,9 +65,17 @@
 #include <openssl/pem.h>
 #include <openssl/x509v3.h>
 
+#include <sys/stat.h>
+
 namespace {
 
-struct X509List;
+const int DetailsCacheSize = 16;
+const int LoadChunkSize = 16;
+const int ReloadDelay = 1000;
+const int DefaultExpiringSoonDays = 30;
+const int PageSize = 256;
+
+const QEvent::Type CertificatesLoadedEvent = QEvent::Type(QEvent::User + 1);
 
 }
 
@@ -100,6 +127,12 @@ struct X509Certificate
         return toDateTime(X509_get_notAfter(x509));
     }
 
+    QString publicKeyAlgorithm() const
+    {
+        EVP_PKEY *key = X509_get0_pubkey(x509);
+        return key ? idToString(EVP_PKEY_id(key), false) : QString();
+    }
+
     QList<QPair<QString, QString>> publicKeyList(bool shortForm = false) const
     {
         QList<QPair<QString, QString>> rv;
@@ -148,6 +181,34 @@ struct X509Certificate
         return rv;
     }
 
+    QByteArray subjectKeyIdentifier() const
+    {
+        return octetsToByteArray(X509_get0_subject_key_id(x509));
+    }
+
+    QByteArray authorityKeyIdentifier() const
+    {
+        return octetsToByteArray(X509_get0_authority_key_id(x509));
+    }
+
+    quint32 subjectNameHash() const
+    {
+        return X509_subject_name_hash(x509);
+    }
+
+    quint32 issuerNameHash() const
+    {
+        return X509_issuer_name_hash(x509);
+    }
+
+    QByteArray toDer() const
+    {
+        QByteArray der(i2d_X509(x509, nullptr), Qt::Uninitialized);
+        unsigned char *data = reinterpret_cast<unsigned char *>(der.data());
+        i2d_X509(x509, &data);
+        return der;
+    }
+
     QList<QPair<QString, QString>> signatureList(bool shortForm = false) const
     {
         QList<QPair<QString, QString>> rv;
@@ -172,9 +233,12 @@ private:
         return QString::fromUtf8(reinterpret_cast<const char*>(ASN1_STRING_get0_data((data))));
     }
 
-    static QString timeToString(ASN1_TIME *data)
+    static QByteArray octetsToByteArray(const ASN1_OCTET_STRING *data)
     {
-        return stringToString(data);
+        if (!data) {
+            return QByteArray();
+        }
+        return QByteArray(reinterpret_cast<const char *>(ASN1_STRING_get0_data(data)), ASN1_STRING_length(data));
     }
 
     static QString idToString(int nid, bool shortForm)
@@ -255,61 +319,76 @@ private:
 
     static QDateTime toDateTime(ASN1_TIME *time)
     {
-        const QString ts(timeToString(time));
-        return (time->type == V_ASN1_GENERALIZEDTIME ? fromGENERALIZEDTIME(ts) : fromUTCTIME(ts));
-    }
+        const char *it = reinterpret_cast<const char *>(ASN1_STRING_get0_data(time));
+        const char *end = it + ASN1_STRING_length(time);
+
+        // UTCTime: "YYMMDDhhmm[ss](Z|(+|-)hhmm)"
+        // GeneralizedTime: "YYYYMMDDhh[mm[ss[.fff]]](Z|(+|-)hhmm)"
+        const bool generalized = (time->type == V_ASN1_GENERALIZEDTIME);
+        int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0, ms = 0;
+        if (!readDigits(&it, end, generalized ? 4 : 2, &year)
+                || !readDigits(&it, end, 2, &month)
+                || !readDigits(&it, end, 2, &day)
+                || !readDigits(&it, end, 2, &hour)) {
+            return QDateTime(QDate(), QTime(), Qt::OffsetFromUTC, 0);
+        }
+        if (readDigits(&it, end, 2, &minute)) {
+            if (readDigits(&it, end, 2, &second) && generalized
+                    && end - it > 1 && *it == '.' && isDigit(it[1])) {
+                ++it;
+                for (int scale = 100; scale > 0 && it != end && isDigit(*it); scale /= 10, ++it) {
+                    ms += (*it - '0') * scale;
+                }
+            }
+        } else if (!generalized) {
+            return QDateTime(QDate(), QTime(), Qt::OffsetFromUTC, 0);
+        }
+        if (!generalized) {
+            year += (year < 70 ? 2000 : 1900);
+        }
 
-    static QDateTime fromUTCTIME(const QString &ts)
-    {
-        QDate d;
-        QTime t;
         int offset = 0;
-
-        // "YYMMDDhhmm[ss](Z|(+|-)hhmm)"
-        const QRegularExpression re("([0-9]{2})([0-9]{2})([0-9]{2})([0-9]{2})([0-9]{2})([0-9]{2})?(Z)?(([+-])([0-9]{2})([0-9]{2}))?");
-        QRegularExpressionMatch match = re.match(ts);
-        if (match.hasMatch()) {
-            int y = match.captured(1).toInt();
-            d = QDate((y < 70 ? 2000 : 1900) + y, match.captured(2).toInt(), match.captured(3).toInt());
-
-            t = QTime(match.captured(4).toInt(), match.captured(5).toInt(), match.captured(6).toInt());
-
-            if (match.lastCapturedIndex() > 7) {
-                offset = match.captured(11).toInt() * 60 + match.captured(10).toInt() * 60*60;
-                if (match.captured(9) == "-") {
+        if (it != end && *it == 'Z') {
+            ++it;
+        }
+        if (it != end && (*it == '+' || *it == '-')) {
+            const bool negative = (*it == '-');
+            const char *pos = it + 1;
+            int offsetHours = 0, offsetMinutes = 0;
+            if (readDigits(&pos, end, 2, &offsetHours) && readDigits(&pos, end, 2, &offsetMinutes)) {
+                offset = offsetMinutes * 60 + offsetHours * 60*60;
+                if (negative) {
                     offset = -offset;
                 }
             }
         }
 
-        return QDateTime(d, t, Qt::OffsetFromUTC, offset);
+        return QDateTime(QDate(year, month, day), QTime(hour, minute, second, ms), Qt::OffsetFromUTC, offset);
     }
 
-    static QDateTime fromGENERALIZEDTIME(const QString &ts)
+    static bool isDigit(char c)
     {
-        QDate d;
-        QTime t;
-        int offset = 0;
-
-        // "YYYYMMDDhh[mm[ss[.fff]]](Z|(+|-)hhmm)" <- nested optionals can be treated as appearing sequentially
-        const QRegularExpression re("([0-9]{4})([0-9]{2})([0-9]{2})([0-9]{2})([0-9]{2})?([0-9]{2})?(\\.[0-9]{1,3})?(Z)?(([+-])([0-9]{2})([0-9]{2}))?");
-        QRegularExpressionMatch match = re.match(ts);
-        if (match.hasMatch()) {
-            d = QDate(match.captured(1).toInt(), match.captured(2).toInt(), match.captured(3).toInt());
+        return c >= '0' && c <= '9';
+    }
 
-            double fraction = match.captured(7).toDouble();
-            int ms = (fraction * 1000);
-            t = QTime(match.captured(4).toInt(), match.captured(5).toInt(), match.captured(6).toInt(), ms);
+    // Reads a fixed width decimal field, advancing past it only on success
+    static bool readDigits(const char **it, const char *end, int width, int *value)
+    {
+        if (end - *it < width) {
+            return false;
+        }
 
-            if (match.lastCapturedIndex() > 8) {
-                offset = match.captured(12).toInt() * 60 + match.captured(11).toInt() * 60*60;
-                if (match.captured(10) == "-") {
-                    offset = -offset;
-                }
+        int v = 0;
+        for (const char *pos = *it, *last = *it + width; pos != last; ++pos) {
+            if (!isDigit(*pos)) {
+                return false;
             }
+            v = v * 10 + (*pos - '0');
         }
 
-        return QDateTime(d, t, Qt::OffsetFromUTC, offset);
+        *it += width;
+        *value = v;
+        return true;
     }
 
     static QList<QPair<QString, QString>> parseData(QString data)
@@ -330,167 +409,225 @@ private:
         return rv;
     }
 
-    friend struct ::X509List;
-
-    X509Certificate(X509 *x) : x509(x) {}
+public:
+    explicit X509Certificate(X509 *x) : x509(x) {}
 
+private:
     X509 *x509 = X509_new();
 };
 
 namespace {
 
-struct X509List
+// Splits a PEM bundle into the blocks of its certificates, so that they can be decoded
+// independently. The blocks refer to the data of the bundle.
+QList<QByteArray> certificateBlocks(const QByteArray &pem)
 {
-    X509List()
-        : crlStack(0), certificateStack(0), pkcs7(0), pkcs7Signed(0)
-    {
-        crlStack = sk_X509_CRL_new_null();
-        if (!crlStack) {
-            qWarning() << "Unable to allocate CRL stack";
-        } else {
-            certificateStack = sk_X509_new_null();
-            if (!certificateStack) {
-                qWarning() << "Unable to allocate X509 stack";
-            } else {
-                pkcs7 = PKCS7_new();
-                pkcs7Signed = PKCS7_SIGNED_new();
-                if (!pkcs7 || !pkcs7Signed) {
-                    qWarning() << "Unable to create PKCS7 structures";
-                } else {
-                    pkcs7Signed->crl = crlStack;
-                    pkcs7Signed->cert = certificateStack;
-
-                    pkcs7->type = OBJ_nid2obj(NID_pkcs7_signed);
-                    pkcs7->d.sign = pkcs7Signed;
-                    pkcs7Signed->contents->type = OBJ_nid2obj(NID_pkcs7_data);
-                    if (!ASN1_INTEGER_set(pkcs7Signed->version, 1)) {
-                        qWarning() << "Unable to set PKCS7 signed version";
-                    }
-                }
-            }
+    static const QByteArray beginLine("-----BEGIN ");
+    static const QByteArray endLine("-----END ");
+    static const QByteArray dashes("-----");
+
+    QList<QByteArray> blocks;
+
+    int index = 0;
+    while ((index = pem.indexOf(beginLine, index)) != -1) {
+        const int nameIndex = index + beginLine.length();
+        const int nameEnd = pem.indexOf(dashes, nameIndex);
+        if (nameEnd == -1) {
+            break;
+        }
+
+        const QByteArray name(pem.mid(nameIndex, nameEnd - nameIndex));
+        const QByteArray end(endLine + name + dashes);
+        const int endIndex = pem.indexOf(end, nameEnd);
+        if (endIndex == -1) {
+            break;
+        }
+
+        const int blockEnd = endIndex + end.length();
+        if (name == PEM_STRING_X509 || name == PEM_STRING_X509_OLD || name == PEM_STRING_X509_TRUSTED) {
+            blocks.append(QByteArray::fromRawData(pem.constData() + index, blockEnd - index));
         }
+        index = blockEnd;
     }
 
-    ~X509List()
-    {
-        /* Apparently, pkcs7Signed and pkcs7 cannot be safely freed...
-        if (pkcs7Signed)
-            PKCS7_SIGNED_free(pkcs7Signed);
-        if (pkcs7)
-            PKCS7_free(pkcs7);
-        */
-        if (certificateStack)
-            sk_X509_free(certificateStack);
-        if (crlStack)
-            sk_X509_CRL_free(crlStack);
+    return blocks;
+}
+
+X509 *decodeDer(const QByteArray &der)
+{
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(der.constData());
+    return d2i_X509(nullptr, &data, der.size());
+}
+
+QList<Certificate> decodeCertificate(const QByteArray &block)
+{
+    QList<Certificate> certificates;
+
+    BIO *input = BIO_new_mem_buf(block.constData(), block.length());
+    if (!input) {
+        qWarning() << "Unable to allocate new BIO while importing in-memory PEM";
+    } else {
+        if (X509 *x509 = PEM_read_bio_X509_AUX(input, NULL, NULL, NULL)) {
+            certificates.append(Certificate(X509Certificate(x509)));
+            X509_free(x509);
+        } else {
+            qWarning() << "Unable to read PEM certificate";
+            ERR_clear_error();
+        }
+        BIO_free(input);
     }
 
-    bool isValid() const
-    {
-        return pkcs7 && pkcs7Signed;
+    return certificates;
+}
+
+void appendCertificates(QList<Certificate> &certificates, const QList<Certificate> &decoded)
+{
+    certificates += decoded;
+}
+
+// Decodes the blocks in parallel, the certificates are returned in the order of the blocks.
+// QtConcurrent decodes on the calling thread as well as on the pool, so a single block or a
+// pool limited to one thread is decoded on the calling thread alone.
+QList<Certificate> decodeCertificates(const QList<QByteArray> &blocks)
+{
+    if (blocks.count() < 2 || QThreadPool::globalInstance()->maxThreadCount() < 2) {
+        QList<Certificate> certificates;
+        for (const QByteArray &block : blocks) {
+            certificates += decodeCertificate(block);
+        }
+        return certificates;
     }
 
-    int count() const
-    {
-        return sk_X509_num(certificateStack);
+    return QtConcurrent::blockingMappedReduced(blocks, decodeCertificate, appendCertificates,
+                                               QtConcurrent::OrderedReduce | QtConcurrent::SequentialReduce);
+}
+
+const QList<QPair<QString, CertificateModel::BundleType> > &bundlePaths()
+{
+    static QList<QPair<QString, CertificateModel::BundleType> > paths;
+    if (paths.isEmpty()) {
+        paths.append(qMakePair(QString("/etc/pki/ca-trust/extracted/pem/tls-ca-bundle.pem"), CertificateModel::TLSBundle));
+        paths.append(qMakePair(QString("/etc/pki/ca-trust/extracted/pem/email-ca-bundle.pem"), CertificateModel::EmailBundle));
+        paths.append(qMakePair(QString("/etc/pki/ca-trust/extracted/pem/objsign-ca-bundle.pem"), CertificateModel::ObjectSigningBundle));
     }
+    return paths;
+}
 
-    void append(X509 *x509)
+QByteArray certificateFingerprint(const Certificate &certificate)
+{
+    return QCryptographicHash::hash(certificate.toDer(), QCryptographicHash::Sha256);
+}
+
+// Binary cache of the certificates extracted from a bundle file. The cache is keyed by the
+// bundle path and validated against the bundle modification time and size, and against a
+// hash of the bundle content when those differ, so that rewriting an unchanged bundle
+// does not invalidate it.
+class CertificateCache
+{
+public:
+    explicit CertificateCache(const QString &bundlePath)
+        : m_bundlePath(bundlePath)
+        , m_bundleInfo(bundlePath)
+        , m_cachePath(cacheDirectory() + QLatin1Char('/')
+                      + QString::fromLatin1(QCryptographicHash::hash(bundlePath.toUtf8(), QCryptographicHash::Sha1).toHex())
+                      + QStringLiteral(".cache"))
     {
-        sk_X509_push(certificateStack, x509);
     }
 
-    void for_each(std::function<void (const X509Certificate &)> fn) const
+    // Reads the cached certificates. If contentHash is empty the bundle modification
+    // time and size must match the cached ones, otherwise the content hash must match.
+    bool read(QList<Certificate> *certificates, const QByteArray &contentHash = QByteArray()) const
     {
-        for (int i = 0, n(count()); i < n; ++i) {
-            fn(X509Certificate(sk_X509_value(certificateStack, i)));
+        QFile file(m_cachePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return false;
         }
-    }
 
-private:
-    STACK_OF(X509_CRL) *crlStack;
-    STACK_OF(X509) *certificateStack;
-    PKCS7 *pkcs7;
-    PKCS7_SIGNED *pkcs7Signed;
-};
+        const qint64 size = file.size();
+        uchar *data = size > 0 ? file.map(0, size) : nullptr;
+        if (!data) {
+            return false;
+        }
 
-struct PKCS7File
-{
-    explicit PKCS7File(const QString &path)
-    {
-        if (!isValid()) {
-            qWarning() << "Unable to prepare X509 certificates structure";
-        } else {
-            BIO *input = BIO_new(BIO_s_file());
-            if (!input) {
-                qWarning() << "Unable to allocate new BIO for:" << path;
-            } else {
-                const QByteArray filename(QFile::encodeName(path));
-                if (BIO_read_filename(input, const_cast<char *>(filename.constData())) <= 0) {
-                    qWarning() << "Unable to open PKCS7 file:" << path;
-                } else {
-                    read_pem_from_bio(input);
-                }
+        const QByteArray buffer(QByteArray::fromRawData(reinterpret_cast<const char *>(data), size));
+        QDataStream stream(buffer);
 
-                BIO_free(input);
-            }
+        quint32 magic = 0;
+        quint32 version = 0;
+        stream >> magic >> version;
+        if (magic != Magic || version != Version) {
+            return false;
         }
-    }
+        stream.setVersion(QDataStream::Qt_5_6);
 
-    explicit PKCS7File(const QByteArray &pem)
-    {
-        if (!isValid()) {
-            qWarning() << "Unable to prepare X509 certificates structure";
-        } else {
-            BIO *input = BIO_new_mem_buf(pem.constData(), pem.length());
-            if (!input) {
-                qWarning() << "Unable to allocate new BIO while importing in-memory PEM";
-            } else {
-                read_pem_from_bio(input);
-                BIO_free(input);
-            }
-        }
-    }
+        QString bundlePath;
+        qint64 modified = 0;
+        qint64 bundleSize = 0;
+        QByteArray hash;
+        stream >> bundlePath >> modified >> bundleSize >> hash;
 
-    void read_pem_from_bio(BIO *input) {
-        STACK_OF(X509_INFO) *certificateStack = PEM_X509_INFO_read_bio(input, NULL, NULL, NULL);
-        if (!certificateStack) {
-            qWarning() << "Unable to read PKCS7 data";
-        } else {
-            while (sk_X509_INFO_num(certificateStack)) {
-                X509_INFO *certificateInfo = sk_X509_INFO_shift(certificateStack);
-                if (certificateInfo->x509 != NULL) {
-                    certs.append(certificateInfo->x509);
-                    certificateInfo->x509 = NULL;
-                }
-                X509_INFO_free(certificateInfo);
+        if (bundlePath != m_bundlePath) {
+            return false;
+        } else if (contentHash.isEmpty()) {
+            if (modified != m_bundleInfo.lastModified().toMSecsSinceEpoch() || bundleSize != m_bundleInfo.size()) {
+                return false;
             }
+        } else if (hash != contentHash) {
+            return false;
+        }
 
-            sk_X509_INFO_free(certificateStack);
+        QList<Certificate> cached;
+        stream >> cached;
+        if (stream.status() != QDataStream::Ok) {
+            qCWarning(lcCertificatesLog) << "Discarding corrupted certificate cache:" << m_cachePath;
+            return false;
         }
-    }
 
-    ~PKCS7File()
-    {
+        qCDebug(lcCertificatesLog) << "Read" << cached.count() << "certificates from cache for" << m_bundlePath;
+        *certificates = cached;
+        return true;
     }
 
-    bool isValid() const
+    void write(const QList<Certificate> &certificates, const QByteArray &contentHash) const
     {
-        return certs.isValid();
-    }
+        if (!QDir().mkpath(cacheDirectory())) {
+            qCDebug(lcCertificatesLog) << "Unable to create certificate cache directory:" << cacheDirectory();
+            return;
+        }
 
-    int count() const
-    {
-        return certs.count();
+        QSaveFile file(m_cachePath);
+        if (!file.open(QIODevice::WriteOnly)) {
+            qCDebug(lcCertificatesLog) << "Unable to write certificate cache:" << m_cachePath;
+            return;
+        }
+
+        QDataStream stream(&file);
+        stream << Magic << Version;
+        stream.setVersion(QDataStream::Qt_5_6);
+        stream << m_bundlePath
+               << m_bundleInfo.lastModified().toMSecsSinceEpoch()
+               << m_bundleInfo.size()
+               << contentHash
+               << certificates;
+
+        if (stream.status() != QDataStream::Ok || !file.commit()) {
+            qCWarning(lcCertificatesLog) << "Unable to write certificate cache:" << m_cachePath;
+        }
     }
 
-    const X509List &getCertificates()
+private:
+    static QString cacheDirectory()
     {
-        return certs;
+        return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+                + QStringLiteral("/nemo-systemsettings/certificates");
     }
 
-private:
-    X509List certs;
+    static const quint32 Magic = 0x4e534343; // "NSCC"
+    static const quint32 Version = 5;
+
+    QString m_bundlePath;
+    QFileInfo m_bundleInfo;
+    QString m_cachePath;
 };
 
 class LibCrypto
@@ -509,41 +646,220 @@ class LibCrypto
     static Initializer init;
 
 public:
-    template<class T>
-    static QList<Certificate> getCertificates(const T &bundleData)
+    // Receives the certificates read from a bundle in chunks along with the fraction
+    // of the bundle read so far. Returning false stops reading.
+    typedef std::function<bool (const QList<Certificate> &, qreal)> ChunkHandler;
+
+    // The cache is writable by the user, so it is only used to fill the rows of the models
+    // and never for certificates handed out to callers
+    enum CacheUsage {
+        UseCache,
+        BypassCache
+    };
+
+    static QList<Certificate> getCertificates(const QString &bundlePath, const ChunkHandler &handler = ChunkHandler(),
+                                              CacheUsage cacheUsage = BypassCache,
+                                              CertificateDirectoryCache *directoryCache = nullptr)
     {
-        PKCS7File bundle(bundleData);
+        QElapsedTimer timer;
+        timer.start();
+
+        if (QFileInfo(bundlePath).isDir()) {
+            const QList<Certificate> certificates(getDirectoryCertificates(bundlePath, handler, directoryCache));
+            qCInfo(lcCertificatesTimingLog, "read bundle=%s source=directory certificates=%d total_ms=%lld",
+                   qPrintable(bundlePath), certificates.count(), timer.elapsed());
+            return certificates;
+        }
+
+        QList<Certificate> certificates;
+
+        CertificateCache cache(bundlePath);
+        if (cacheUsage == UseCache && cache.read(&certificates)) {
+            qCInfo(lcCertificatesTimingLog, "read bundle=%s source=cache certificates=%d total_ms=%lld",
+                   qPrintable(bundlePath), certificates.count(), timer.elapsed());
+            if (handler) {
+                handler(certificates, 1.0);
+            }
+            return certificates;
+        }
+
+        QFile file(bundlePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning() << "Unable to open PKCS7 file:" << bundlePath;
+            return certificates;
+        }
+
+        const QByteArray pem(readFile(&file));
+        const QByteArray contentHash(QCryptographicHash::hash(pem, QCryptographicHash::Sha256));
+        const qint64 readTime = timer.elapsed();
+
+        // The bundle may have been rewritten without changing its content
+        const char *source = "parse";
+        if (cacheUsage == UseCache && cache.read(&certificates, contentHash)) {
+            source = "cache-content";
+            if (handler) {
+                handler(certificates, 1.0);
+            }
+        } else if (!handler) {
+            certificates = getCertificates(pem);
+        } else if (!readCertificates(pem, handler, &certificates)) {
+            // Reading was cancelled, don't cache a partial bundle
+            return certificates;
+        }
+        const qint64 decodeTime = timer.elapsed() - readTime;
+
+        cache.write(certificates, contentHash);
+
+        qCInfo(lcCertificatesTimingLog, "read bundle=%s source=%s certificates=%d bytes=%d read_ms=%lld decode_ms=%lld total_ms=%lld",
+               qPrintable(bundlePath), source, certificates.count(), pem.size(), readTime, decodeTime, timer.elapsed());
+        return certificates;
+    }
 
-        return bundleToCertificates(bundle);
+    static QList<Certificate> getCertificates(const QByteArray &pem)
+    {
+        return decodeCertificates(certificateBlocks(pem));
     }
 private:
-    static QList<Certificate> bundleToCertificates(PKCS7File &bundle)
+    // Reads a directory of certificate files, such as an OpenSSL hashed directory or
+    // p11-kit anchors. With a cache, the files unchanged since the previous read are not
+    // parsed again.
+    static QList<Certificate> getDirectoryCertificates(const QString &path, const ChunkHandler &handler,
+                                                       CertificateDirectoryCache *cache)
     {
+        CertificateDirectoryCache unused;
+        if (!cache) {
+            cache = &unused;
+        }
+        QMutexLocker locker(&cache->mutex);
+
+        const QFileInfoList entries(QDir(path).entryInfoList(QDir::Files | QDir::Readable, QDir::Name));
+
+        QHash<QString, CertificateDirectoryCache::File> current;
         QList<Certificate> certificates;
-        if (bundle.isValid() && bundle.count() > 0) {
-            certificates.reserve(bundle.count());
-            bundle.getCertificates().for_each([&certificates](const X509Certificate &cert) {
-                certificates.append(Certificate(cert));
-            });
+        QList<Certificate> chunk;
+        // A bundle file in the directory may repeat the certificates of the other files
+        QSet<QByteArray> fingerprints;
+        int parsed = 0;
+        for (int i = 0; i < entries.count(); ++i) {
+            // The hash named entries are links to the certificate files
+            const QString filePath(entries.at(i).canonicalFilePath());
+            struct stat64 fileStat;
+            if (!filePath.isEmpty() && !current.contains(filePath)
+                    && ::stat64(QFile::encodeName(filePath).constData(), &fileStat) == 0) {
+                // The change time catches files edited in place with their modification time restored
+                const qint64 modified = qint64(fileStat.st_mtim.tv_sec) * 1000000000 + fileStat.st_mtim.tv_nsec;
+                const qint64 changed = qint64(fileStat.st_ctim.tv_sec) * 1000000000 + fileStat.st_ctim.tv_nsec;
+                CertificateDirectoryCache::File entry = cache->files.value(filePath);
+                if (!cache->files.contains(filePath)
+                        || entry.modified != modified || entry.changed != changed
+                        || entry.inode != quint64(fileStat.st_ino) || entry.size != qint64(fileStat.st_size)) {
+                    entry.modified = modified;
+                    entry.changed = changed;
+                    entry.inode = fileStat.st_ino;
+                    entry.size = fileStat.st_size;
+                    entry.certificates = getFileCertificates(filePath);
+                    ++parsed;
+                }
+                current.insert(filePath, entry);
+                for (const Certificate &certificate : entry.certificates) {
+                    const QByteArray fingerprint(certificateFingerprint(certificate));
+                    if (!fingerprints.contains(fingerprint)) {
+                        fingerprints.insert(fingerprint);
+                        chunk.append(certificate);
+                    }
+                }
+            }
+
+            if (handler && (chunk.count() >= LoadChunkSize || i == entries.count() - 1)) {
+                certificates += chunk;
+                if (!handler(chunk, qreal(i + 1) / entries.count())) {
+                    return certificates;
+                }
+                chunk.clear();
+            }
         }
+        certificates += chunk;
+
+        qCDebug(lcCertificatesLog) << "Parsed" << parsed << "of" << current.count() << "files in" << path;
 
+        cache->files = current;
         return certificates;
     }
-};
 
+    static QList<Certificate> getFileCertificates(const QString &filePath)
+    {
+        QFile file(filePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qCWarning(lcCertificatesLog) << "Unable to open certificate file:" << filePath;
+            return QList<Certificate>();
+        }
 
-LibCrypto::Initializer LibCrypto::init;
+        const QByteArray data(readFile(&file));
+        const QList<QByteArray> blocks(certificateBlocks(data));
+        if (!blocks.isEmpty()) {
+            return decodeCertificates(blocks);
+        }
 
-const QList<QPair<QString, CertificateModel::BundleType> > &bundlePaths()
-{
-    static QList<QPair<QString, CertificateModel::BundleType> > paths;
-    if (paths.isEmpty()) {
-        paths.append(qMakePair(QString("/etc/pki/ca-trust/extracted/pem/tls-ca-bundle.pem"), CertificateModel::TLSBundle));
-        paths.append(qMakePair(QString("/etc/pki/ca-trust/extracted/pem/email-ca-bundle.pem"), CertificateModel::EmailBundle));
-        paths.append(qMakePair(QString("/etc/pki/ca-trust/extracted/pem/objsign-ca-bundle.pem"), CertificateModel::ObjectSigningBundle));
+        // Not PEM, the file may hold a single DER encoded certificate
+        QList<Certificate> certificates;
+        if (X509 *x509 = decodeDer(data)) {
+            certificates.append(Certificate(X509Certificate(x509)));
+            X509_free(x509);
+        } else {
+            ERR_clear_error();
+        }
+        return certificates;
     }
-    return paths;
-}
+
+    // Maps the system bundles, the data remains valid while the file is open. These are
+    // replaced rather than truncated when updated, so the mapping stays intact. Other files
+    // may be truncated in place, which would fault on access to the mapping, so they are read.
+    static QByteArray readFile(QFile *file)
+    {
+        const qint64 size = file->size();
+        if (size > 0 && isSystemBundle(file->fileName())) {
+            if (uchar *data = file->map(0, size)) {
+                return QByteArray::fromRawData(reinterpret_cast<const char *>(data), size);
+            }
+        }
+        return file->readAll();
+    }
+
+    static bool isSystemBundle(const QString &path)
+    {
+        const QList<QPair<QString, CertificateModel::BundleType> > &bundles(bundlePaths());
+        for (auto it = bundles.cbegin(), end = bundles.cend(); it != end; ++it) {
+            if (it->first == path) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool readCertificates(const QByteArray &pem, const ChunkHandler &handler, QList<Certificate> *certificates)
+    {
+        const QList<QByteArray> blocks(certificateBlocks(pem));
+
+        // Deliver a small first chunk quickly, then decode larger chunks across all cores
+        int chunkSize = LoadChunkSize;
+        for (int index = 0; index < blocks.count(); index += chunkSize) {
+            if (index > 0) {
+                chunkSize = LoadChunkSize * qMax(1, QThread::idealThreadCount());
+            }
+
+            const QList<Certificate> chunk(decodeCertificates(blocks.mid(index, chunkSize)));
+            *certificates += chunk;
+            if (!handler(chunk, qreal(qMin(index + chunkSize, blocks.count())) / blocks.count())) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+
+LibCrypto::Initializer LibCrypto::init;
 
 CertificateModel::BundleType bundleType(const QString &path)
 {
@@ -573,97 +889,846 @@ QString bundlePath(CertificateModel::BundleType type)
     return QStringLiteral("");
 }
 
+bool certificateLessThan(const Certificate &lhs, const Certificate &rhs)
+{
+    return lhs.sortKey() < rhs.sortKey();
 }
 
-Certificate::Certificate(const X509Certificate &cert)
-    : m_commonName(cert.subjectElement(NID_commonName))
-    , m_countryName(cert.subjectElement(NID_countryName))
-    , m_organizationName(cert.subjectElement(NID_organizationName))
-    , m_organizationalUnitName(cert.subjectElement(NID_organizationalUnitName))
-    , m_notValidBefore(cert.notBefore())
-    , m_notValidAfter(cert.notAfter())
+// Extends the last run of inserted rows, as (first row, count), or starts a new one
+void appendRun(QList<QPair<int, int> > *runs, int row)
 {
-    // Yield consistent names for the certificates, despite inconsistent naming policy
-    QString Certificate::*members[] = { &Certificate::m_commonName, &Certificate::m_organizationalUnitName, &Certificate::m_organizationName, &Certificate::m_countryName };
-    for (auto it = std::begin(members); it != std::end(members); ++it) {
-        const QString &s(this->*(*it));
-        if (!s.isEmpty()) {
-            if (m_primaryName.isEmpty()) {
-                m_primaryName = s;
-            } else if (m_secondaryName.isEmpty()) {
-                m_secondaryName = s;
-                break;
-            }
-        }
+    if (!runs->isEmpty() && runs->last().first + runs->last().second == row) {
+        ++runs->last().second;
+    } else {
+        runs->append(qMakePair(row, 1));
     }
+}
 
-    // Matches QSslCertificate::issuerDisplayName() introducd in Qt 5.12
-    // Returns a name that describes the issuer. It returns the CommonName if
-    // available, otherwise falls back to the Organization or the first
-    // OrganizationalUnitName.
-    m_issuerDisplayName = cert.issuerElement(NID_commonName);
-    if (m_issuerDisplayName.isEmpty()) {
-        m_issuerDisplayName = cert.issuerElement(NID_countryName);
-    }
-    if (m_issuerDisplayName.isEmpty()) {
-        m_issuerDisplayName = cert.issuerElement(NID_organizationName);
-    }
+bool expiresBefore(const Certificate &lhs, const Certificate &rhs)
+{
+    return lhs.notValidAfter() < rhs.notValidAfter();
+}
 
-    // Populate the details map
-    m_details.insert(QStringLiteral("Version"), QVariant(cert.version()));
-    m_details.insert(QStringLiteral("SerialNumber"), QVariant(cert.serialNumber()));
-    m_details.insert(QStringLiteral("SubjectDisplayName"), QVariant(m_primaryName));
-    m_details.insert(QStringLiteral("OrganizationName"), QVariant(m_organizationName));
-    m_details.insert(QStringLiteral("IssuerDisplayName"), QVariant(m_issuerDisplayName));
+bool validFromBefore(const Certificate &lhs, const Certificate &rhs)
+{
+    return lhs.notValidBefore() < rhs.notValidBefore();
+}
 
-    QVariantMap validity;
-    validity.insert(QStringLiteral("NotBefore"), QVariant(cert.notBefore()));
-    validity.insert(QStringLiteral("NotAfter"), QVariant(cert.notAfter()));
-    m_details.insert(QStringLiteral("Validity"), QVariant(validity));
+// The range of a list sorted by expiry with notValidAfter in [from, to)
+QPair<int, int> expiryRange(const QList<Certificate> &certificates, const QDateTime &from, const QDateTime &to)
+{
+    auto first = certificates.cbegin();
+    if (from.isValid()) {
+        first = std::lower_bound(certificates.cbegin(), certificates.cend(), from,
+                                 [](const Certificate &certificate, const QDateTime &time) {
+            return certificate.notValidAfter() < time;
+        });
+    }
 
-    QVariantMap issuer;
-    const QList<QPair<QString, QString>> &issuerDetails(cert.issuerList());
-    for (auto it = issuerDetails.cbegin(), end = issuerDetails.cend(); it != end; ++it) {
-        issuer.insert(it->first, QVariant(it->second));
+    auto last = certificates.cend();
+    if (to.isValid()) {
+        last = std::lower_bound(first, certificates.cend(), to,
+                                [](const Certificate &certificate, const QDateTime &time) {
+            return certificate.notValidAfter() < time;
+        });
     }
-    m_details.insert(QStringLiteral("Issuer"), QVariant(issuer));
 
-    QVariantMap subject;
-    const QList<QPair<QString, QString>> &subjectDetails(cert.subjectList());
-    for (auto it = subjectDetails.cbegin(), end = subjectDetails.cend(); it != end; ++it) {
+    return qMakePair(int(first - certificates.cbegin()), int(last - certificates.cbegin()));
+}
+
+class CertificatesEvent : public QEvent
+{
+public:
+    CertificatesEvent(int generation, const QList<Certificate> &certificates, qreal progress, bool finished)
+        : QEvent(CertificatesLoadedEvent)
+        , m_generation(generation)
+        , m_certificates(certificates)
+        , m_progress(progress)
+        , m_finished(finished)
+    {
+    }
+
+    int m_generation;
+    QList<Certificate> m_certificates;
+    qreal m_progress;
+    bool m_finished;
+};
+
+class CertificateLoadTask : public QRunnable
+{
+public:
+    CertificateLoadTask(const QString &bundlePath, LibCrypto::CacheUsage cacheUsage,
+                        const QSharedPointer<CertificateLoadState> &state)
+        : m_bundlePath(bundlePath)
+        , m_cacheUsage(cacheUsage)
+        , m_state(state)
+        , m_loadGeneration(state->generation.load())
+    {
+    }
+
+    void run() override
+    {
+        LibCrypto::getCertificates(m_bundlePath, [this](const QList<Certificate> &certificates, qreal progress) {
+            if (!isCurrent()) {
+                return false;
+            }
+
+            QList<Certificate> chunk(certificates);
+            std::stable_sort(chunk.begin(), chunk.end(), certificateLessThan);
+            post(new CertificatesEvent(m_loadGeneration, chunk, progress, false));
+            return true;
+        }, m_cacheUsage, &m_state->directoryCache);
+
+        if (isCurrent()) {
+            post(new CertificatesEvent(m_loadGeneration, QList<Certificate>(), 1.0, true));
+        }
+    }
+
+private:
+    bool isCurrent() const
+    {
+        return m_state->generation.load() == m_loadGeneration;
+    }
+
+    void post(CertificatesEvent *event)
+    {
+        // The bundle cannot be destroyed while the lock is held
+        QMutexLocker locker(&m_state->mutex);
+        if (m_state->owner && isCurrent()) {
+            QCoreApplication::postEvent(m_state->owner, event);
+        } else {
+            delete event;
+        }
+    }
+
+    QString m_bundlePath;
+    LibCrypto::CacheUsage m_cacheUsage;
+    QSharedPointer<CertificateLoadState> m_state;
+    int m_loadGeneration;
+};
+
+// Populates the details map, this is expensive so it is done only on request
+QVariantMap certificateDetails(const X509Certificate &cert, const Certificate &certificate)
+{
+    QVariantMap details;
+
+    details.insert(QStringLiteral("Version"), QVariant(cert.version()));
+    details.insert(QStringLiteral("SerialNumber"), QVariant(cert.serialNumber()));
+    details.insert(QStringLiteral("SubjectDisplayName"), QVariant(certificate.primaryName()));
+    details.insert(QStringLiteral("OrganizationName"), QVariant(certificate.organizationName()));
+    details.insert(QStringLiteral("IssuerDisplayName"), QVariant(certificate.issuerDisplayName()));
+
+    QVariantMap validity;
+    validity.insert(QStringLiteral("NotBefore"), QVariant(cert.notBefore()));
+    validity.insert(QStringLiteral("NotAfter"), QVariant(cert.notAfter()));
+    details.insert(QStringLiteral("Validity"), QVariant(validity));
+
+    QVariantMap issuer;
+    const QList<QPair<QString, QString>> &issuerDetails(cert.issuerList());
+    for (auto it = issuerDetails.cbegin(), end = issuerDetails.cend(); it != end; ++it) {
+        issuer.insert(it->first, QVariant(it->second));
+    }
+    details.insert(QStringLiteral("Issuer"), QVariant(issuer));
+
+    QVariantMap subject;
+    const QList<QPair<QString, QString>> &subjectDetails(cert.subjectList());
+    for (auto it = subjectDetails.cbegin(), end = subjectDetails.cend(); it != end; ++it) {
         subject.insert(it->first, QVariant(it->second));
     }
-    m_details.insert(QStringLiteral("Subject"), QVariant(subject));
+    details.insert(QStringLiteral("Subject"), QVariant(subject));
+
+    QVariantMap publicKey;
+    const QList<QPair<QString, QString>> &keyDetails(cert.publicKeyList());
+    for (auto it = keyDetails.cbegin(), end = keyDetails.cend(); it != end; ++it) {
+        // publicKeyList() adds "Bits" and "Algorithm" fields which include the same thing more nicely
+        if (it->first == QLatin1String("Public-Key") || it->first == QLatin1String("RSA Public-Key")) {
+            continue;
+        }
+        publicKey.insert(it->first, QVariant(it->second));
+    }
+    details.insert(QStringLiteral("SubjectPublicKeyInfo"), QVariant(publicKey));
+
+    QVariantMap extensions;
+    const QList<QPair<QString, QString>> &extensionDetails(cert.extensionList());
+    for (auto it = extensionDetails.cbegin(), end = extensionDetails.cend(); it != end; ++it) {
+        extensions.insert(it->first, QVariant(it->second));
+    }
+    details.insert(QStringLiteral("Extensions"), extensions);
+
+    QVariantMap signature;
+    const QList<QPair<QString, QString>> &signatureDetails(cert.signatureList());
+    for (auto it = signatureDetails.cbegin(), end = signatureDetails.cend(); it != end; ++it) {
+        signature.insert(it->first, QVariant(it->second));
+    }
+    details.insert(QStringLiteral("Signature"), signature);
+
+    return details;
+}
+
+}
+
+Certificate::Certificate(const X509Certificate &cert)
+    : m_commonName(cert.subjectElement(NID_commonName))
+    , m_countryName(cert.subjectElement(NID_countryName))
+    , m_organizationName(cert.subjectElement(NID_organizationName))
+    , m_organizationalUnitName(cert.subjectElement(NID_organizationalUnitName))
+    , m_notValidBefore(cert.notBefore())
+    , m_notValidAfter(cert.notAfter())
+    , m_keyAlgorithm(cert.publicKeyAlgorithm())
+    , m_der(cert.toDer())
+    , m_subjectNameHash(cert.subjectNameHash())
+    , m_issuerNameHash(cert.issuerNameHash())
+    , m_subjectKeyIdentifier(cert.subjectKeyIdentifier())
+    , m_authorityKeyIdentifier(cert.authorityKeyIdentifier())
+{
+    // Yield consistent names for the certificates, despite inconsistent naming policy
+    QString Certificate::*members[] = { &Certificate::m_commonName, &Certificate::m_organizationalUnitName, &Certificate::m_organizationName, &Certificate::m_countryName };
+    for (auto it = std::begin(members); it != std::end(members); ++it) {
+        const QString &s(this->*(*it));
+        if (!s.isEmpty()) {
+            if (m_primaryName.isEmpty()) {
+                m_primaryName = s;
+            } else if (m_secondaryName.isEmpty()) {
+                m_secondaryName = s;
+                break;
+            }
+        }
+    }
+
+    // Matches QSslCertificate::issuerDisplayName() introducd in Qt 5.12
+    // Returns a name that describes the issuer. It returns the CommonName if
+    // available, otherwise falls back to the Organization or the first
+    // OrganizationalUnitName.
+    m_issuerDisplayName = cert.issuerElement(NID_commonName);
+    if (m_issuerDisplayName.isEmpty()) {
+        m_issuerDisplayName = cert.issuerElement(NID_countryName);
+    }
+    if (m_issuerDisplayName.isEmpty()) {
+        m_issuerDisplayName = cert.issuerElement(NID_organizationName);
+    }
+
+    updateKeys();
+}
+
+Certificate::Certificate()
+    : m_subjectNameHash(0)
+    , m_issuerNameHash(0)
+{
+}
+
+void Certificate::updateKeys()
+{
+    // Comparing the folded names with a null separator orders by primary name, then secondary
+    m_sortKey = m_primaryName.toCaseFolded() + QChar(QChar::Null) + m_secondaryName.toCaseFolded();
+
+    const QChar separator(QChar::LineFeed);
+    m_searchKey = (m_commonName + separator + m_organizationName + separator + m_organizationalUnitName
+                   + separator + m_countryName + separator + m_issuerDisplayName).toCaseFolded();
+}
+
+QVariantMap Certificate::details() const
+{
+    if (m_der.isEmpty()) {
+        return QVariantMap();
+    }
+
+    // Keep the details of the most recently viewed certificates around
+    static QMutex mutex;
+    static QCache<QByteArray, QVariantMap> cache(DetailsCacheSize);
+
+    QMutexLocker locker(&mutex);
+    if (const QVariantMap *details = cache.object(m_der)) {
+        return *details;
+    }
+
+    X509 *x509 = decodeDer(m_der);
+    if (!x509) {
+        qCWarning(lcCertificatesLog) << "Unable to decode certificate" << m_primaryName;
+        return QVariantMap();
+    }
+
+    const QVariantMap details(certificateDetails(X509Certificate(x509), *this));
+    X509_free(x509);
+
+    cache.insert(m_der, new QVariantMap(details));
+    return details;
+}
+
+QDataStream &operator<<(QDataStream &stream, const Certificate &certificate)
+{
+    stream << certificate.m_commonName
+           << certificate.m_countryName
+           << certificate.m_organizationName
+           << certificate.m_organizationalUnitName
+           << certificate.m_primaryName
+           << certificate.m_secondaryName
+           << certificate.m_notValidBefore
+           << certificate.m_notValidAfter
+           << certificate.m_issuerDisplayName
+           << certificate.m_keyAlgorithm
+           << certificate.m_der
+           << certificate.m_subjectNameHash
+           << certificate.m_issuerNameHash
+           << certificate.m_subjectKeyIdentifier
+           << certificate.m_authorityKeyIdentifier;
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, Certificate &certificate)
+{
+    stream >> certificate.m_commonName
+           >> certificate.m_countryName
+           >> certificate.m_organizationName
+           >> certificate.m_organizationalUnitName
+           >> certificate.m_primaryName
+           >> certificate.m_secondaryName
+           >> certificate.m_notValidBefore
+           >> certificate.m_notValidAfter
+           >> certificate.m_issuerDisplayName
+           >> certificate.m_keyAlgorithm
+           >> certificate.m_der
+           >> certificate.m_subjectNameHash
+           >> certificate.m_issuerNameHash
+           >> certificate.m_subjectKeyIdentifier
+           >> certificate.m_authorityKeyIdentifier;
+    certificate.updateKeys();
+    return stream;
+}
+
+namespace {
+
+// Bundles currently in use, by path
+QHash<QString, CertificateBundle *> &bundleRegistry()
+{
+    static QHash<QString, CertificateBundle *> bundles;
+    return bundles;
+}
+
+// Bundles used for lookups are kept loaded once they have been indexed. The holder is never
+// destroyed, as the registry and the store may be gone by then, the bundles are released
+// when the application quits instead.
+CertificateBundle *indexedBundle(const QString &path)
+{
+    typedef QHash<QString, QExplicitlySharedDataPointer<CertificateBundle> > BundleHash;
+    static BundleHash * const bundles = new BundleHash;
+
+    if (bundles->isEmpty()) {
+        if (QCoreApplication *application = QCoreApplication::instance()) {
+            QObject::connect(application, &QCoreApplication::aboutToQuit, []() {
+                bundles->clear();
+            });
+        }
+    }
+
+    QExplicitlySharedDataPointer<CertificateBundle> &bundle((*bundles)[path]);
+    if (!bundle) {
+        bundle = CertificateBundle::instance(path);
+    }
+    bundle->loadUncached();
+    return bundle.data();
+}
+
+}
+
+// Certificates held by the loaded bundles, so that a certificate present in several bundles
+// and the names repeated between certificates are stored only once. Like the bundles, this is
+// used only from the thread owning them.
+class CertificateStore
+{
+public:
+    static Certificate share(const Certificate &certificate)
+    {
+        CertificateStore &store(instance());
+
+        const QByteArray fingerprint(certificateFingerprint(certificate));
+        auto it = store.m_certificates.constFind(fingerprint);
+        if (it != store.m_certificates.constEnd()) {
+            return *it;
+        }
+
+        Certificate shared(certificate);
+        store.intern(&shared);
+        store.m_certificates.insert(fingerprint, shared);
+        return shared;
+    }
+
+    static QList<Certificate> share(const QList<Certificate> &certificates)
+    {
+        QList<Certificate> shared;
+        shared.reserve(certificates.count());
+        for (const Certificate &certificate : certificates) {
+            shared.append(share(certificate));
+        }
+        return shared;
+    }
+
+    // Drops the certificates no longer held by any bundle
+    static void prune()
+    {
+        CertificateStore &store(instance());
+
+        QSet<QByteArray> live;
+        const QHash<QString, CertificateBundle *> &bundles(bundleRegistry());
+        for (auto it = bundles.cbegin(), end = bundles.cend(); it != end; ++it) {
+            for (const Certificate &certificate : (*it)->certificates()) {
+                live.insert(certificateFingerprint(certificate));
+            }
+        }
+
+        store.m_strings.clear();
+        for (auto it = store.m_certificates.begin(); it != store.m_certificates.end();) {
+            if (live.contains(it.key())) {
+                store.intern(&it.value());
+                ++it;
+            } else {
+                it = store.m_certificates.erase(it);
+            }
+        }
+    }
+
+private:
+    static CertificateStore &instance()
+    {
+        static CertificateStore store;
+        return store;
+    }
+
+    void intern(Certificate *certificate)
+    {
+        QString Certificate::*members[] = {
+            &Certificate::m_commonName, &Certificate::m_countryName, &Certificate::m_organizationName,
+            &Certificate::m_organizationalUnitName, &Certificate::m_primaryName, &Certificate::m_secondaryName,
+            &Certificate::m_issuerDisplayName, &Certificate::m_keyAlgorithm
+        };
+        for (auto it = std::begin(members); it != std::end(members); ++it) {
+            QString &s(certificate->*(*it));
+            if (!s.isEmpty()) {
+                s = *m_strings.insert(s);
+            }
+        }
+    }
+
+    QHash<QByteArray, Certificate> m_certificates;
+    QSet<QString> m_strings;
+};
+
+CertificateBundle::CertificateBundle(const QString &path)
+    : m_path(path)
+    , m_loadState(new CertificateLoadState)
+    , m_indexValid(false)
+    , m_validityIndexValid(false)
+    , m_progress(0)
+    , m_loaded(false)
+    , m_loading(false)
+    , m_asynchronous(false)
+    , m_replacing(false)
+    , m_uncached(false)
+{
+    m_loadState->owner = this;
+    bundleRegistry().insert(m_path, this);
+
+    m_reloadTimer.setSingleShot(true);
+    m_reloadTimer.setInterval(ReloadDelay);
+    connect(&m_reloadTimer, &QTimer::timeout, this, &CertificateBundle::reload);
+
+    // The bundles are replaced rather than rewritten when updated, so the directory
+    // is watched as well to pick up the file again once it has been recreated
+    const QString directory(QFileInfo(m_path).absolutePath());
+    connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, [this](const QString &path) {
+        if (!m_watcher.files().contains(path) && QFile::exists(path)) {
+            m_watcher.addPath(path);
+        }
+        m_reloadTimer.start();
+    });
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, [this](const QString &path) {
+        if (path == m_path) {
+            // A certificate directory, only the changed files are parsed again
+            m_reloadTimer.start();
+        } else if (!m_watcher.files().contains(m_path) && QFile::exists(m_path)) {
+            m_watcher.addPath(m_path);
+            m_reloadTimer.start();
+        }
+    });
+
+    if (QFile::exists(m_path)) {
+        m_watcher.addPath(m_path);
+    }
+    if (!QFileInfo(m_path).isDir() && QFile::exists(directory)) {
+        m_watcher.addPath(directory);
+    }
+}
+
+CertificateBundle::~CertificateBundle()
+{
+    // Discard the results of any load still in progress
+    {
+        QMutexLocker locker(&m_loadState->mutex);
+        m_loadState->owner = nullptr;
+        m_loadState->generation.ref();
+    }
+
+    bundleRegistry().remove(m_path);
+    CertificateStore::prune();
+}
+
+QExplicitlySharedDataPointer<CertificateBundle> CertificateBundle::instance(const QString &path)
+{
+    CertificateBundle *bundle = bundleRegistry().value(path);
+    if (!bundle) {
+        bundle = new CertificateBundle(path);
+    }
+    return QExplicitlySharedDataPointer<CertificateBundle>(bundle);
+}
+
+QString CertificateBundle::path() const
+{
+    return m_path;
+}
+
+QList<Certificate> CertificateBundle::certificates() const
+{
+    return m_certificates;
+}
+
+void CertificateBundle::load(bool asynchronous)
+{
+    // A synchronous load supersedes an asynchronous one which is still running
+    if (m_loaded || (m_loading && asynchronous)) {
+        return;
+    }
+
+    startLoad(asynchronous);
+}
+
+void CertificateBundle::loadUncached()
+{
+    // Certificates already read through the cache are read again from the bundle itself
+    if (!m_uncached) {
+        m_uncached = true;
+        startLoad(false);
+    } else {
+        load(false);
+    }
+}
+
+bool CertificateBundle::isLoading() const
+{
+    return m_loading;
+}
+
+qreal CertificateBundle::progress() const
+{
+    return m_progress;
+}
+
+bool CertificateBundle::containsFingerprint(const QByteArray &fingerprint) const
+{
+    updateIndex();
+    return m_fingerprintIndex.contains(fingerprint);
+}
+
+QList<Certificate> CertificateBundle::certificatesWithSubjectNameHash(quint32 hash) const
+{
+    updateIndex();
+    return m_subjectIndex.values(hash);
+}
+
+bool CertificateBundle::findIssuer(const Certificate &certificate, Certificate *issuer) const
+{
+    updateIndex();
+
+    // A self-signed certificate ends the chain
+    const QByteArray &authorityKeyId(certificate.authorityKeyIdentifier());
+    if (certificate.subjectNameHash() == certificate.issuerNameHash()
+            && (authorityKeyId.isEmpty() || authorityKeyId == certificate.subjectKeyIdentifier())) {
+        return false;
+    }
+
+    // Prefer the key identifier, which tells apart reissued certificates with the same name
+    if (!authorityKeyId.isEmpty()) {
+        for (auto it = m_keyIdentifierIndex.constFind(authorityKeyId);
+                it != m_keyIdentifierIndex.constEnd() && it.key() == authorityKeyId; ++it) {
+            if (it->subjectNameHash() == certificate.issuerNameHash()) {
+                *issuer = *it;
+                return true;
+            }
+        }
+    }
+
+    for (auto it = m_subjectIndex.constFind(certificate.issuerNameHash());
+            it != m_subjectIndex.constEnd() && it.key() == certificate.issuerNameHash(); ++it) {
+        if (authorityKeyId.isEmpty() || it->subjectKeyIdentifier().isEmpty()) {
+            *issuer = *it;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+QList<Certificate> CertificateBundle::certificatesExpiringBetween(const QDateTime &from, const QDateTime &to) const
+{
+    updateValidityIndex();
+
+    const auto range(expiryRange(m_expiryIndex, from, to));
+    return m_expiryIndex.mid(range.first, range.second - range.first);
+}
+
+int CertificateBundle::countExpiringBetween(const QDateTime &from, const QDateTime &to) const
+{
+    updateValidityIndex();
+
+    const auto range(expiryRange(m_expiryIndex, from, to));
+    return range.second - range.first;
+}
+
+QList<Certificate> CertificateBundle::certificatesNotValidAt(const QDateTime &time) const
+{
+    updateValidityIndex();
+
+    auto it = std::upper_bound(m_validFromIndex.cbegin(), m_validFromIndex.cend(), time,
+                               [](const QDateTime &time, const Certificate &certificate) {
+        return time < certificate.notValidBefore();
+    });
+    return m_validFromIndex.mid(it - m_validFromIndex.cbegin());
+}
+
+void CertificateBundle::updateIndex() const
+{
+    if (m_indexValid) {
+        return;
+    }
+
+    m_fingerprintIndex.clear();
+    m_subjectIndex.clear();
+    m_keyIdentifierIndex.clear();
+    m_fingerprintIndex.reserve(m_certificates.count() * 2);
+    m_subjectIndex.reserve(m_certificates.count());
+    for (const Certificate &certificate : m_certificates) {
+        const QByteArray der(certificate.toDer());
+        m_fingerprintIndex.insert(QCryptographicHash::hash(der, QCryptographicHash::Sha1), certificate);
+        m_fingerprintIndex.insert(QCryptographicHash::hash(der, QCryptographicHash::Sha256), certificate);
+        m_subjectIndex.insert(certificate.subjectNameHash(), certificate);
+        if (!certificate.subjectKeyIdentifier().isEmpty()) {
+            m_keyIdentifierIndex.insert(certificate.subjectKeyIdentifier(), certificate);
+        }
+    }
+    m_indexValid = true;
+}
+
+void CertificateBundle::updateValidityIndex() const
+{
+    if (m_validityIndexValid) {
+        return;
+    }
+
+    m_expiryIndex = m_certificates;
+    m_validFromIndex = m_certificates;
+    std::sort(m_expiryIndex.begin(), m_expiryIndex.end(), expiresBefore);
+    std::sort(m_validFromIndex.begin(), m_validFromIndex.end(), validFromBefore);
+    m_validityIndexValid = true;
+}
+
+bool CertificateBundle::event(QEvent *event)
+{
+    if (event->type() == CertificatesLoadedEvent) {
+        CertificatesEvent *loaded = static_cast<CertificatesEvent *>(event);
+        if (loaded->m_generation == m_loadState->generation.load()) {
+            if (m_replacing) {
+                m_pendingCertificates += loaded->m_certificates;
+            } else {
+                addCertificates(loaded->m_certificates);
+            }
+            setProgress(loaded->m_progress);
+
+            if (loaded->m_finished) {
+                if (m_replacing) {
+                    std::stable_sort(m_pendingCertificates.begin(), m_pendingCertificates.end(), certificateLessThan);
+                    setCertificates(m_pendingCertificates);
+                    m_pendingCertificates.clear();
+                    m_replacing = false;
+                }
+                qCInfo(lcCertificatesTimingLog, "load bundle=%s mode=async certificates=%d total_ms=%lld",
+                       qPrintable(m_path), m_certificates.count(), m_loadTimer.elapsed());
+                m_loaded = true;
+                setLoading(false);
+            }
+        }
+        return true;
+    }
+
+    return QObject::event(event);
+}
+
+void CertificateBundle::reload()
+{
+    if (m_loaded || m_loading) {
+        qCDebug(lcCertificatesLog) << "Reloading changed certificate bundle" << m_path;
+        startLoad(m_asynchronous);
+    }
+}
+
+void CertificateBundle::startLoad(bool asynchronous)
+{
+    // Discard the results of any load still in progress
+    m_loadState->generation.ref();
+    m_asynchronous = asynchronous;
+    m_loaded = false;
+
+    m_loadTimer.start();
+
+    if (QFileInfo(m_path).isDir()) {
+        watchDirectoryFiles();
+    }
+
+    const LibCrypto::CacheUsage cacheUsage = m_uncached ? LibCrypto::BypassCache : LibCrypto::UseCache;
+    if (asynchronous) {
+        // The first load is shown as it progresses, a reload is applied only once complete
+        m_replacing = !m_certificates.isEmpty();
+        m_pendingCertificates.clear();
+        QThreadPool::globalInstance()->start(new CertificateLoadTask(m_path, cacheUsage, m_loadState));
+        setProgress(0);
+        setLoading(true);
+    } else {
+        QList<Certificate> certificates(LibCrypto::getCertificates(m_path, LibCrypto::ChunkHandler(), cacheUsage,
+                                                                   &m_loadState->directoryCache));
+        const qint64 readTime = m_loadTimer.elapsed();
+        std::stable_sort(certificates.begin(), certificates.end(), certificateLessThan);
+        qCInfo(lcCertificatesTimingLog, "load bundle=%s mode=sync certificates=%d read_ms=%lld sort_ms=%lld",
+               qPrintable(m_path), certificates.count(), readTime, m_loadTimer.elapsed() - readTime);
+        m_replacing = false;
+        m_pendingCertificates.clear();
+        setCertificates(certificates);
+        m_loaded = true;
+        setProgress(1);
+        setLoading(false);
+    }
+}
+
+// Files edited in place don't change the directory, so each file is watched as well
+void CertificateBundle::watchDirectoryFiles()
+{
+    QSet<QString> files;
+    for (const QFileInfo &entry : QDir(m_path).entryInfoList(QDir::Files | QDir::Readable)) {
+        const QString filePath(entry.canonicalFilePath());
+        if (!filePath.isEmpty()) {
+            files.insert(filePath);
+        }
+    }
+
+    QStringList removed;
+    for (const QString &filePath : m_watcher.files()) {
+        if (!files.remove(filePath)) {
+            removed.append(filePath);
+        }
+    }
+
+    if (!removed.isEmpty()) {
+        m_watcher.removePaths(removed);
+    }
+    if (!files.isEmpty()) {
+        m_watcher.addPaths(files.toList());
+    }
+}
+
+void CertificateBundle::setCertificates(const QList<Certificate> &loaded)
+{
+    const QList<Certificate> certificates(CertificateStore::share(loaded));
+
+    QSet<QByteArray> previous;
+    QList<QByteArray> previousFingerprints;
+    previousFingerprints.reserve(m_certificates.count());
+    for (const Certificate &certificate : m_certificates) {
+        previousFingerprints.append(certificateFingerprint(certificate));
+        previous.insert(previousFingerprints.last());
+    }
 
-    QVariantMap publicKey;
-    const QList<QPair<QString, QString>> &keyDetails(cert.publicKeyList());
-    for (auto it = keyDetails.cbegin(), end = keyDetails.cend(); it != end; ++it) {
-        // publicKeyList() adds "Bits" and "Algorithm" fields which include the same thing more nicely
-        if (it->first == QLatin1String("Public-Key") || it->first == QLatin1String("RSA Public-Key")) {
-            continue;
+    QSet<QByteArray> current;
+    QList<Certificate> added;
+    for (const Certificate &certificate : certificates) {
+        const QByteArray fingerprint(certificateFingerprint(certificate));
+        current.insert(fingerprint);
+        if (!previous.contains(fingerprint)) {
+            added.append(certificate);
         }
-        publicKey.insert(it->first, QVariant(it->second));
     }
-    m_details.insert(QStringLiteral("SubjectPublicKeyInfo"), QVariant(publicKey));
 
-    QVariantMap extensions;
-    const QList<QPair<QString, QString>> &extensionDetails(cert.extensionList());
-    for (auto it = extensionDetails.cbegin(), end = extensionDetails.cend(); it != end; ++it) {
-        extensions.insert(it->first, QVariant(it->second));
+    QList<Certificate> removed;
+    for (int i = 0; i < m_certificates.count(); ++i) {
+        if (!current.contains(previousFingerprints.at(i))) {
+            removed.append(m_certificates.at(i));
+        }
     }
-    m_details.insert(QStringLiteral("Extensions"), extensions);
 
-    QVariantMap signature;
-    const QList<QPair<QString, QString>> &signatureDetails(cert.signatureList());
-    for (auto it = signatureDetails.cbegin(), end = signatureDetails.cend(); it != end; ++it) {
-        signature.insert(it->first, QVariant(it->second));
+    m_certificates = certificates;
+    m_indexValid = false;
+    m_validityIndexValid = false;
+
+    if (!removed.isEmpty()) {
+        emit certificatesRemoved(removed);
+    }
+    if (!added.isEmpty()) {
+        emit certificatesAdded(added);
+    }
+
+    if (!removed.isEmpty()) {
+        CertificateStore::prune();
+    }
+}
+
+void CertificateBundle::addCertificates(const QList<Certificate> &loaded)
+{
+    if (loaded.isEmpty()) {
+        return;
+    }
+
+    const QList<Certificate> certificates(CertificateStore::share(loaded));
+
+    const int count = m_certificates.count();
+    m_certificates += certificates;
+    std::inplace_merge(m_certificates.begin(), m_certificates.begin() + count, m_certificates.end(), certificateLessThan);
+    m_indexValid = false;
+
+    // Merge the chunk into the validity lists rather than sorting them again for every chunk
+    if (m_validityIndexValid) {
+        QList<Certificate> sorted(certificates);
+        std::sort(sorted.begin(), sorted.end(), expiresBefore);
+        m_expiryIndex += sorted;
+        std::inplace_merge(m_expiryIndex.begin(), m_expiryIndex.end() - sorted.count(), m_expiryIndex.end(), expiresBefore);
+
+        std::sort(sorted.begin(), sorted.end(), validFromBefore);
+        m_validFromIndex += sorted;
+        std::inplace_merge(m_validFromIndex.begin(), m_validFromIndex.end() - sorted.count(), m_validFromIndex.end(), validFromBefore);
+    }
+
+    emit certificatesAdded(certificates);
+}
+
+void CertificateBundle::setLoading(bool loading)
+{
+    if (m_loading != loading) {
+        m_loading = loading;
+        emit loadingChanged();
+    }
+}
+
+void CertificateBundle::setProgress(qreal progress)
+{
+    if (m_progress != progress) {
+        m_progress = progress;
+        emit progressChanged();
     }
-    m_details.insert(QStringLiteral("Signature"), signature);
 }
 
 CertificateModel::CertificateModel(QObject *parent)
     : QAbstractListModel(parent)
     , m_type(NoBundle)
+    , m_expiringSoonDays(DefaultExpiringSoonDays)
+    , m_expiringSoonCount(0)
+    , m_fetchedCount(0)
+    , m_fetchLimit(PageSize)
+    , m_asynchronous(false)
+    , m_complete(true)
 {
 }
 
@@ -698,7 +1763,9 @@ void CertificateModel::setBundlePath(const QString &path)
 {
     if (m_path != path) {
         m_path = path;
-        refresh();
+        if (m_complete) {
+            refresh();
+        }
 
         const BundleType type(::bundleType(m_path));
         setBundleType(type);
@@ -707,16 +1774,180 @@ void CertificateModel::setBundlePath(const QString &path)
     }
 }
 
+bool CertificateModel::asynchronous() const
+{
+    return m_asynchronous;
+}
+
+void CertificateModel::setAsynchronous(bool asynchronous)
+{
+    if (m_asynchronous != asynchronous) {
+        m_asynchronous = asynchronous;
+        emit asynchronousChanged();
+    }
+}
+
+void CertificateModel::classBegin()
+{
+    m_complete = false;
+}
+
+void CertificateModel::componentComplete()
+{
+    m_complete = true;
+    if (!m_path.isEmpty()) {
+        refresh();
+    }
+}
+
+bool CertificateModel::loading() const
+{
+    return m_bundle && m_bundle->isLoading();
+}
+
+qreal CertificateModel::progress() const
+{
+    return m_bundle ? m_bundle->progress() : 0;
+}
+
+QString CertificateModel::filterText() const
+{
+    return m_filterText;
+}
+
+void CertificateModel::setFilterText(const QString &text)
+{
+    if (m_filterText != text) {
+        const QString folded(text.toCaseFolded());
+        const bool narrowing = folded.contains(m_foldedFilterText);
+
+        m_filterText = text;
+        m_foldedFilterText = folded;
+        updateFilter(narrowing);
+
+        emit filterTextChanged();
+    }
+}
+
+QString CertificateModel::filterIssuer() const
+{
+    return m_filterIssuer;
+}
+
+void CertificateModel::setFilterIssuer(const QString &issuer)
+{
+    if (m_filterIssuer != issuer) {
+        const bool narrowing = m_filterIssuer.isEmpty();
+
+        m_filterIssuer = issuer;
+        updateFilter(narrowing);
+
+        emit filterIssuerChanged();
+    }
+}
+
+QString CertificateModel::filterKeyAlgorithm() const
+{
+    return m_filterKeyAlgorithm;
+}
+
+void CertificateModel::setFilterKeyAlgorithm(const QString &algorithm)
+{
+    if (m_filterKeyAlgorithm != algorithm) {
+        const bool narrowing = m_filterKeyAlgorithm.isEmpty();
+
+        m_filterKeyAlgorithm = algorithm;
+        updateFilter(narrowing);
+
+        emit filterKeyAlgorithmChanged();
+    }
+}
+
+QDateTime CertificateModel::filterExpiresAfter() const
+{
+    return m_filterExpiresAfter;
+}
+
+void CertificateModel::setFilterExpiresAfter(const QDateTime &time)
+{
+    if (m_filterExpiresAfter != time) {
+        const bool narrowing = !m_filterExpiresAfter.isValid() || (time.isValid() && time > m_filterExpiresAfter);
+
+        m_filterExpiresAfter = time;
+        updateFilter(narrowing);
+
+        emit filterExpiresAfterChanged();
+    }
+}
+
+QDateTime CertificateModel::filterExpiresBefore() const
+{
+    return m_filterExpiresBefore;
+}
+
+void CertificateModel::setFilterExpiresBefore(const QDateTime &time)
+{
+    if (m_filterExpiresBefore != time) {
+        const bool narrowing = !m_filterExpiresBefore.isValid() || (time.isValid() && time < m_filterExpiresBefore);
+
+        m_filterExpiresBefore = time;
+        updateFilter(narrowing);
+
+        emit filterExpiresBeforeChanged();
+    }
+}
+
+int CertificateModel::expiringSoonDays() const
+{
+    return m_expiringSoonDays;
+}
+
+void CertificateModel::setExpiringSoonDays(int days)
+{
+    if (m_expiringSoonDays != days) {
+        m_expiringSoonDays = days;
+        updateExpiringSoonCount();
+
+        emit expiringSoonDaysChanged();
+    }
+}
+
+int CertificateModel::expiringSoonCount() const
+{
+    return m_expiringSoonCount;
+}
+
+int CertificateModel::totalCount() const
+{
+    return m_certificates.count();
+}
+
 int CertificateModel::rowCount(const QModelIndex & parent) const
 {
     Q_UNUSED(parent)
-    return m_certificates.count();
+    return m_fetchedCount;
+}
+
+bool CertificateModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && m_fetchedCount < m_certificates.count();
+}
+
+void CertificateModel::fetchMore(const QModelIndex &parent)
+{
+    const int count = parent.isValid() ? 0 : qMin(PageSize, m_certificates.count() - m_fetchedCount);
+    if (count > 0) {
+        beginInsertRows(QModelIndex(), m_fetchedCount, m_fetchedCount + count - 1);
+        m_fetchedCount += count;
+        m_fetchLimit = qMax(m_fetchLimit, m_fetchedCount);
+        endInsertRows();
+    }
 }
 
 QVariant CertificateModel::data(const QModelIndex &index, int role) const
 {
     int row = index.row();
-    if (row < 0 || row >= m_certificates.count()) {
+    if (row < 0 || row >= m_fetchedCount) {
         return QVariant();
     }
 
@@ -740,6 +1971,8 @@ QVariant CertificateModel::data(const QModelIndex &index, int role) const
         return cert.notValidAfter();
     case DetailsRole:
         return cert.details();
+    case KeyAlgorithmRole:
+        return cert.keyAlgorithm();
     default:
         break;
     }
@@ -747,6 +1980,48 @@ QVariant CertificateModel::data(const QModelIndex &index, int role) const
     return QVariant();
 }
 
+int CertificateModel::issuedBy(int row) const
+{
+    Certificate issuer;
+    if (row < 0 || row >= m_fetchedCount || !m_bundle
+            || !m_bundle->findIssuer(m_certificates.at(row), &issuer)) {
+        return -1;
+    }
+
+    return rowOf(issuer);
+}
+
+QVariantList CertificateModel::chainFor(int row) const
+{
+    QVariantList chain;
+    if (row < 0 || row >= m_fetchedCount || !m_bundle) {
+        return chain;
+    }
+
+    // Guard against issuer cycles between cross-signed certificates
+    QSet<QByteArray> visited;
+    Certificate certificate(m_certificates.at(row));
+    Certificate issuer;
+    do {
+        visited.insert(certificate.toDer());
+
+        QVariantMap entry;
+        entry.insert(QStringLiteral("primaryName"), certificate.primaryName());
+        entry.insert(QStringLiteral("secondaryName"), certificate.secondaryName());
+        entry.insert(QStringLiteral("issuerDisplayName"), certificate.issuerDisplayName());
+        entry.insert(QStringLiteral("notValidBefore"), certificate.notValidBefore());
+        entry.insert(QStringLiteral("notValidAfter"), certificate.notValidAfter());
+        entry.insert(QStringLiteral("row"), rowOf(certificate));
+        chain.append(entry);
+        if (!m_bundle->findIssuer(certificate, &issuer)) {
+            break;
+        }
+        certificate = issuer;
+    } while (!visited.contains(certificate.toDer()));
+
+    return chain;
+}
+
 QHash<int, QByteArray> CertificateModel::roleNames() const
 {
     QHash<int, QByteArray> roles;
@@ -760,37 +2035,315 @@ QHash<int, QByteArray> CertificateModel::roleNames() const
     roles[NotValidBeforeRole] = "notValidBefore";
     roles[NotValidAfterRole] = "notValidAfter";
     roles[DetailsRole] = "details";
+    roles[KeyAlgorithmRole] = "keyAlgorithm";
 
     return roles;
 }
+
 void CertificateModel::refresh()
 {
+    QElapsedTimer timer;
+    timer.start();
+
+    const bool wasLoading = loading();
+    const qreal previousProgress = progress();
+
+    if (m_bundle) {
+        disconnect(m_bundle.data(), nullptr, this, nullptr);
+    }
+
     beginResetModel();
     if (m_path.isEmpty()) {
+        m_bundle.reset();
         m_certificates.clear();
     } else {
-        m_certificates = getCertificates(m_path);
-        std::stable_sort(m_certificates.begin(), m_certificates.end(), [](const Certificate &lhs, const Certificate &rhs) {
-            int c = lhs.primaryName().compare(rhs.primaryName(), Qt::CaseInsensitive);
-            if (c < 0)
-                return true;
-            if (c > 0)
-                return false;
-            c = lhs.secondaryName().compare(rhs.secondaryName(), Qt::CaseInsensitive);
-            if (c < 0)
-                return true;
-            return false;
-        });
+        // Models showing the same bundle share the parsed certificates
+        m_bundle = CertificateBundle::instance(m_path);
+        m_bundle->load(m_asynchronous);
+
+        m_certificates.clear();
+        for (const Certificate &certificate : m_bundle->certificates()) {
+            if (filterAccepts(certificate)) {
+                m_certificates.append(certificate);
+            }
+        }
+
+        connect(m_bundle.data(), &CertificateBundle::certificatesAdded, this, &CertificateModel::insertCertificates);
+        connect(m_bundle.data(), &CertificateBundle::certificatesRemoved, this, &CertificateModel::removeCertificates);
+        connect(m_bundle.data(), &CertificateBundle::loadingChanged, this, &CertificateModel::loadingChanged);
+        connect(m_bundle.data(), &CertificateBundle::progressChanged, this, &CertificateModel::progressChanged);
+        connect(m_bundle.data(), &CertificateBundle::loadingChanged, this, &CertificateModel::updateExpiringSoonCount);
+        connect(m_bundle.data(), &CertificateBundle::certificatesAdded, this, &CertificateModel::updateExpiringSoonCount);
+        connect(m_bundle.data(), &CertificateBundle::certificatesRemoved, this, &CertificateModel::updateExpiringSoonCount);
     }
+    m_fetchedCount = qMin(m_certificates.count(), PageSize);
+    m_fetchLimit = PageSize;
     endResetModel();
+
+    qCInfo(lcCertificatesTimingLog, "refresh bundle=%s rows=%d fetched=%d total_ms=%lld",
+           qPrintable(m_path), m_certificates.count(), m_fetchedCount, timer.elapsed());
+
+    emit totalCountChanged();
+    updateExpiringSoonCount();
+
+    if (loading() != wasLoading) {
+        emit loadingChanged();
+    }
+    if (progress() != previousProgress) {
+        emit progressChanged();
+    }
+}
+
+void CertificateModel::insertCertificates(const QList<Certificate> &added)
+{
+    // Both lists are sorted, so they are merged in one pass, the added certificates after
+    // the rows with an equal sort key as in the bundle
+    QList<Certificate> merged;
+    merged.reserve(m_certificates.count() + added.count());
+    QList<QPair<int, int> > runs;
+
+    auto row = m_certificates.cbegin();
+    for (const Certificate &certificate : added) {
+        if (!filterAccepts(certificate)) {
+            continue;
+        }
+        for (; row != m_certificates.cend() && !certificateLessThan(certificate, *row); ++row) {
+            merged.append(*row);
+        }
+        appendRun(&runs, merged.count());
+        merged.append(certificate);
+    }
+    for (; row != m_certificates.cend(); ++row) {
+        merged.append(*row);
+    }
+
+    mergeCertificates(merged, runs);
+}
+
+void CertificateModel::mergeCertificates(const QList<Certificate> &merged, const QList<QPair<int, int> > &runs)
+{
+    // Only the runs within the fetched rows are signalled, each as one contiguous insertion
+    for (const QPair<int, int> &run : runs) {
+        const int row = run.first;
+        const int count = run.second;
+
+        // The fetched rows never grow past the limit, only fetchMore() raises it. Rows inserted
+        // within them push the last fetched rows out, and the rest of the run stays unfetched.
+        const int visible = (row <= m_fetchedCount && row < m_fetchLimit) ? qMin(count, m_fetchLimit - row) : 0;
+        if (visible == 0) {
+            // The later runs are further down and all unfetched
+            break;
+        }
+
+        const int pushed = m_fetchedCount + visible - m_fetchLimit;
+        if (pushed > 0) {
+            beginRemoveRows(QModelIndex(), m_fetchedCount - pushed, m_fetchedCount - 1);
+            m_fetchedCount -= pushed;
+            endRemoveRows();
+        }
+
+        beginInsertRows(QModelIndex(), row, row + visible - 1);
+        const int previousCount = m_certificates.count();
+        m_certificates += merged.mid(row, count);
+        std::rotate(m_certificates.begin() + row, m_certificates.begin() + previousCount, m_certificates.end());
+        m_fetchedCount += visible;
+        endInsertRows();
+    }
+
+    // The rows past the signalled runs are unfetched, so the merged list replaces them at once
+    m_certificates = merged;
+
+    if (!runs.isEmpty()) {
+        emit totalCountChanged();
+    }
+}
+
+void CertificateModel::removeCertificates(const QList<Certificate> &certificates)
+{
+    QSet<QByteArray> fingerprints;
+    for (const Certificate &certificate : certificates) {
+        fingerprints.insert(certificateFingerprint(certificate));
+    }
+
+    removeCertificatesIf([&fingerprints](const Certificate &certificate) {
+        return fingerprints.contains(certificateFingerprint(certificate));
+    });
+}
+
+void CertificateModel::removeCertificatesIf(const std::function<bool (const Certificate &)> &predicate)
+{
+    bool removed = false;
+
+    // Remove contiguous runs from the end, so that the earlier rows stay valid
+    for (int row = m_certificates.count() - 1; row >= 0;) {
+        if (!predicate(m_certificates.at(row))) {
+            --row;
+            continue;
+        }
+
+        int first = row;
+        while (first > 0 && predicate(m_certificates.at(first - 1))) {
+            --first;
+        }
+
+        if (first < m_fetchedCount) {
+            const int lastVisible = qMin(row, m_fetchedCount - 1);
+            beginRemoveRows(QModelIndex(), first, lastVisible);
+            m_certificates.erase(m_certificates.begin() + first, m_certificates.begin() + row + 1);
+            m_fetchedCount -= lastVisible - first + 1;
+            endRemoveRows();
+        } else {
+            m_certificates.erase(m_certificates.begin() + first, m_certificates.begin() + row + 1);
+        }
+        removed = true;
+
+        row = first - 1;
+    }
+
+    if (removed) {
+        emit totalCountChanged();
+    }
+}
+
+void CertificateModel::updateFilter(bool narrowing)
+{
+    removeCertificatesIf([this](const Certificate &certificate) {
+        return !filterAccepts(certificate);
+    });
+
+    // A narrower filter can only drop rows, otherwise look for the newly accepted certificates.
+    // The rows are a subsequence of the bundle, so the new list is built in one pass over it.
+    if (!narrowing && m_bundle) {
+        const QList<Certificate> bundle(m_bundle->certificates());
+        QList<Certificate> merged;
+        merged.reserve(bundle.count());
+        QList<QPair<int, int> > runs;
+
+        int shown = 0;
+        for (const Certificate &certificate : bundle) {
+            if (shown < m_certificates.count() && m_certificates.at(shown).toDer() == certificate.toDer()) {
+                merged.append(certificate);
+                ++shown;
+            } else if (filterAccepts(certificate)) {
+                appendRun(&runs, merged.count());
+                merged.append(certificate);
+            }
+        }
+
+        mergeCertificates(merged, runs);
+    }
+}
+
+void CertificateModel::updateExpiringSoonCount()
+{
+    // Counted once the load has finished, rather than for every chunk of it
+    if (m_bundle && m_bundle->isLoading()) {
+        return;
+    }
+
+    int count = 0;
+    if (m_bundle) {
+        const QDateTime now(QDateTime::currentDateTimeUtc());
+        count = m_bundle->countExpiringBetween(now, now.addDays(m_expiringSoonDays));
+    }
+
+    if (m_expiringSoonCount != count) {
+        m_expiringSoonCount = count;
+        emit expiringSoonCountChanged();
+    }
+}
+
+int CertificateModel::rowOf(const Certificate &certificate) const
+{
+    // The rows are sorted, so only those with an equal sort key need to be compared
+    auto it = std::lower_bound(m_certificates.cbegin(), m_certificates.cend(), certificate, certificateLessThan);
+    for (; it != m_certificates.cend() && !certificateLessThan(certificate, *it); ++it) {
+        if (it->toDer() == certificate.toDer()) {
+            const int row = it - m_certificates.cbegin();
+            return row < m_fetchedCount ? row : -1;
+        }
+    }
+    return -1;
+}
+
+bool CertificateModel::filterAccepts(const Certificate &certificate) const
+{
+    if (!m_foldedFilterText.isEmpty() && !certificate.searchKey().contains(m_foldedFilterText)) {
+        return false;
+    }
+    if (!m_filterIssuer.isEmpty()
+            && m_filterIssuer.compare(certificate.issuerDisplayName(), Qt::CaseInsensitive) != 0) {
+        return false;
+    }
+    if (!m_filterKeyAlgorithm.isEmpty()
+            && m_filterKeyAlgorithm.compare(certificate.keyAlgorithm(), Qt::CaseInsensitive) != 0) {
+        return false;
+    }
+    if (m_filterExpiresAfter.isValid() && certificate.notValidAfter() < m_filterExpiresAfter) {
+        return false;
+    }
+    if (m_filterExpiresBefore.isValid() && certificate.notValidAfter() > m_filterExpiresBefore) {
+        return false;
+    }
+    return true;
 }
 
 QList<Certificate> CertificateModel::getCertificates(const QString &bundlePath)
 {
-    return LibCrypto::getCertificates(bundlePath);
+    return LibCrypto::getCertificates(bundlePath, LibCrypto::ChunkHandler(), LibCrypto::BypassCache);
 }
 
 QList<Certificate> CertificateModel::getCertificates(const QByteArray &pem)
 {
     return LibCrypto::getCertificates(pem);
 }
+
+bool CertificateModel::containsCertificate(const QString &bundlePath, const QByteArray &der)
+{
+    return containsFingerprint(bundlePath, QCryptographicHash::hash(der, QCryptographicHash::Sha256));
+}
+
+bool CertificateModel::containsFingerprint(const QString &bundlePath, const QByteArray &fingerprint)
+{
+    return indexedBundle(bundlePath)->containsFingerprint(fingerprint);
+}
+
+QList<Certificate> CertificateModel::findIssuers(const QString &bundlePath, const QByteArray &der)
+{
+    QList<Certificate> issuers;
+
+    X509 *subject = decodeDer(der);
+    if (!subject) {
+        return issuers;
+    }
+
+    // The name hash may collide, so confirm each candidate
+    const QList<Certificate> candidates(indexedBundle(bundlePath)->certificatesWithSubjectNameHash(X509_issuer_name_hash(subject)));
+    for (const Certificate &candidate : candidates) {
+        if (X509 *issuer = decodeDer(candidate.toDer())) {
+            if (X509_check_issued(issuer, subject) == X509_V_OK) {
+                issuers.append(candidate);
+            }
+            X509_free(issuer);
+        }
+    }
+
+    X509_free(subject);
+    return issuers;
+}
+
+QList<Certificate> CertificateModel::expiredCertificates(const QString &bundlePath)
+{
+    return indexedBundle(bundlePath)->certificatesExpiringBetween(QDateTime(), QDateTime::currentDateTimeUtc());
+}
+
+QList<Certificate> CertificateModel::expiringCertificates(const QString &bundlePath, int days)
+{
+    const QDateTime now(QDateTime::currentDateTimeUtc());
+    return indexedBundle(bundlePath)->certificatesExpiringBetween(now, now.addDays(days));
+}
+
+QList<Certificate> CertificateModel::notYetValidCertificates(const QString &bundlePath)
+{
+    return indexedBundle(bundlePath)->certificatesNotValidAt(QDateTime::currentDateTimeUtc());
+}
@@ -35,17 +35,31 @@
 
 #include <QAbstractListModel>
 #include <QDateTime>
+#include <QExplicitlySharedDataPointer>
 #include <QList>
+#include <QPair>
+#include <QQmlParserStatus>
 #include <QVariantMap>
 
+#include <functional>
+
 #include "systemsettingsglobal.h"
 
 
+class QDataStream;
+
 struct X509Certificate;
 
+class Certificate;
+class CertificateBundle;
+
+SYSTEMSETTINGS_EXPORT QDataStream &operator<<(QDataStream &stream, const Certificate &certificate);
+SYSTEMSETTINGS_EXPORT QDataStream &operator>>(QDataStream &stream, Certificate &certificate);
+
 class SYSTEMSETTINGS_EXPORT Certificate
 {
 public:
+    Certificate();
     Certificate(const X509Certificate &cert);
 
     QString commonName() const { return m_commonName; }
@@ -58,11 +72,33 @@ public:
     QDateTime notValidBefore() const { return m_notValidBefore; }
     QDateTime notValidAfter() const { return m_notValidAfter; }
 
-    QVariantMap details() const { return m_details; }
+    QVariantMap details() const;
 
     QString issuerDisplayName() const { return m_issuerDisplayName; }
 
+    QString keyAlgorithm() const { return m_keyAlgorithm; }
+
+    QByteArray toDer() const { return m_der; }
+
+    // The OpenSSL hashes of the subject and issuer names, as used in hashed certificate directories
+    quint32 subjectNameHash() const { return m_subjectNameHash; }
+    quint32 issuerNameHash() const { return m_issuerNameHash; }
+
+    // The key identifier extensions, empty if not present
+    const QByteArray &subjectKeyIdentifier() const { return m_subjectKeyIdentifier; }
+    const QByteArray &authorityKeyIdentifier() const { return m_authorityKeyIdentifier; }
+
+    // Case folded keys, to sort and filter without locale aware comparisons
+    const QString &sortKey() const { return m_sortKey; }
+    const QString &searchKey() const { return m_searchKey; }
+
 private:
+    friend QDataStream &operator<<(QDataStream &stream, const Certificate &certificate);
+    friend QDataStream &operator>>(QDataStream &stream, Certificate &certificate);
+    friend class CertificateStore;
+
+    void updateKeys();
+
     QString m_commonName;
     QString m_countryName;
     QString m_organizationName;
@@ -74,15 +110,37 @@ private:
     QDateTime m_notValidAfter;
 
     QString m_issuerDisplayName;
+    QString m_keyAlgorithm;
+
+    // The details are extracted from the DER encoding on demand
+    QByteArray m_der;
+
+    quint32 m_subjectNameHash;
+    quint32 m_issuerNameHash;
+    QByteArray m_subjectKeyIdentifier;
+    QByteArray m_authorityKeyIdentifier;
 
-    QVariantMap m_details;
+    QString m_sortKey;
+    QString m_searchKey;
 };
 
-class SYSTEMSETTINGS_EXPORT CertificateModel: public QAbstractListModel
+class SYSTEMSETTINGS_EXPORT CertificateModel: public QAbstractListModel, public QQmlParserStatus
 {
     Q_OBJECT
+    Q_INTERFACES(QQmlParserStatus)
     Q_PROPERTY(BundleType bundleType READ bundleType WRITE setBundleType NOTIFY bundleTypeChanged)
     Q_PROPERTY(QString bundlePath READ bundlePath WRITE setBundlePath NOTIFY bundlePathChanged)
+    Q_PROPERTY(bool asynchronous READ asynchronous WRITE setAsynchronous NOTIFY asynchronousChanged)
+    Q_PROPERTY(bool loading READ loading NOTIFY loadingChanged)
+    Q_PROPERTY(qreal progress READ progress NOTIFY progressChanged)
+    Q_PROPERTY(QString filterText READ filterText WRITE setFilterText NOTIFY filterTextChanged)
+    Q_PROPERTY(QString filterIssuer READ filterIssuer WRITE setFilterIssuer NOTIFY filterIssuerChanged)
+    Q_PROPERTY(QString filterKeyAlgorithm READ filterKeyAlgorithm WRITE setFilterKeyAlgorithm NOTIFY filterKeyAlgorithmChanged)
+    Q_PROPERTY(QDateTime filterExpiresAfter READ filterExpiresAfter WRITE setFilterExpiresAfter NOTIFY filterExpiresAfterChanged)
+    Q_PROPERTY(QDateTime filterExpiresBefore READ filterExpiresBefore WRITE setFilterExpiresBefore NOTIFY filterExpiresBeforeChanged)
+    Q_PROPERTY(int expiringSoonDays READ expiringSoonDays WRITE setExpiringSoonDays NOTIFY expiringSoonDaysChanged)
+    Q_PROPERTY(int expiringSoonCount READ expiringSoonCount NOTIFY expiringSoonCountChanged)
+    Q_PROPERTY(int totalCount READ totalCount NOTIFY totalCountChanged)
     Q_ENUMS(BundleType)
 
 public:
@@ -104,6 +162,7 @@ public:
         NotValidBeforeRole = Qt::UserRole + 7,
         NotValidAfterRole = Qt::UserRole + 8,
         DetailsRole = Qt::UserRole + 9,
+        KeyAlgorithmRole = Qt::UserRole + 10,
     };
 
     explicit CertificateModel(QObject *parent = 0);
@@ -115,15 +174,84 @@ public:
     QString bundlePath() const;
     void setBundlePath(const QString &path);
 
+    // Parse the bundle in a worker thread. A model declared in QML loads its bundle once the
+    // component is complete, so this applies whether it is set before or after the bundle.
+    bool asynchronous() const;
+    void setAsynchronous(bool asynchronous);
+
+    bool loading() const;
+    qreal progress() const;
+
+    // Case insensitive substring of the subject and issuer names
+    QString filterText() const;
+    void setFilterText(const QString &text);
+
+    // Case insensitive match of the issuer display name
+    QString filterIssuer() const;
+    void setFilterIssuer(const QString &issuer);
+
+    // Case insensitive match of the public key algorithm
+    QString filterKeyAlgorithm() const;
+    void setFilterKeyAlgorithm(const QString &algorithm);
+
+    // Bounds of the expiry time, an invalid time leaves the bound open
+    QDateTime filterExpiresAfter() const;
+    void setFilterExpiresAfter(const QDateTime &time);
+    QDateTime filterExpiresBefore() const;
+    void setFilterExpiresBefore(const QDateTime &time);
+
+    // The number of certificates in the bundle, regardless of the filters, which have not
+    // expired yet but will within the given number of days
+    int expiringSoonDays() const;
+    void setExpiringSoonDays(int days);
+    int expiringSoonCount() const;
+
+    // The number of certificates matching the filters, rows are fetched in pages as the view needs them
+    int totalCount() const;
+
+    virtual void classBegin();
+    virtual void componentComplete();
+
     virtual int rowCount(const QModelIndex & parent = QModelIndex()) const;
+    virtual bool canFetchMore(const QModelIndex &parent) const;
+    virtual void fetchMore(const QModelIndex &parent);
     virtual QVariant data(const QModelIndex &index, int role) const;
 
+    // The row of the certificate issuing the one in the given row, or -1 if it is not shown
+    Q_INVOKABLE int issuedBy(int row) const;
+    // The certificate in the given row followed by its issuers found in the bundle, up to the root
+    Q_INVOKABLE QVariantList chainFor(int row) const;
+
+    // Always parses the bundle, the certificate cache is only used to fill the rows of the models
     static QList<Certificate> getCertificates(const QString &bundlePath);
     static QList<Certificate> getCertificates(const QByteArray &pem);
 
+    // Lookups in a bundle, which is loaded and indexed on first use and then kept up to date.
+    // Like the models, these are to be used from the main thread.
+    static bool containsCertificate(const QString &bundlePath, const QByteArray &der);
+    // Either a SHA-1 or a SHA-256 fingerprint of the DER encoding
+    static bool containsFingerprint(const QString &bundlePath, const QByteArray &fingerprint);
+    static QList<Certificate> findIssuers(const QString &bundlePath, const QByteArray &der);
+    // Sorted by expiry time
+    static QList<Certificate> expiredCertificates(const QString &bundlePath);
+    static QList<Certificate> expiringCertificates(const QString &bundlePath, int days);
+    // Sorted by the start of validity
+    static QList<Certificate> notYetValidCertificates(const QString &bundlePath);
+
 Q_SIGNALS:
     void bundleTypeChanged();
     void bundlePathChanged();
+    void asynchronousChanged();
+    void loadingChanged();
+    void progressChanged();
+    void filterTextChanged();
+    void filterIssuerChanged();
+    void filterKeyAlgorithmChanged();
+    void filterExpiresAfterChanged();
+    void filterExpiresBeforeChanged();
+    void expiringSoonDaysChanged();
+    void expiringSoonCountChanged();
+    void totalCountChanged();
 
 protected:
     void refresh();
@@ -131,9 +259,32 @@ protected:
     QHash<int, QByteArray> roleNames() const;
 
 private:
+    void insertCertificates(const QList<Certificate> &certificates);
+    void mergeCertificates(const QList<Certificate> &merged, const QList<QPair<int, int> > &runs);
+    void removeCertificates(const QList<Certificate> &certificates);
+    void removeCertificatesIf(const std::function<bool (const Certificate &)> &predicate);
+    void updateFilter(bool narrowing);
+    bool filterAccepts(const Certificate &certificate) const;
+    int rowOf(const Certificate &certificate) const;
+    void updateExpiringSoonCount();
+
     BundleType m_type;
     QString m_path;
     QList<Certificate> m_certificates;
+    QExplicitlySharedDataPointer<CertificateBundle> m_bundle;
+    QString m_filterText;
+    QString m_foldedFilterText;
+    QString m_filterIssuer;
+    QString m_filterKeyAlgorithm;
+    QDateTime m_filterExpiresAfter;
+    QDateTime m_filterExpiresBefore;
+    int m_expiringSoonDays;
+    int m_expiringSoonCount;
+    int m_fetchedCount;
+    // The most rows exposed before the next fetchMore()
+    int m_fetchLimit;
+    bool m_asynchronous;
+    bool m_complete;
 };
 
 #endif
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2016 - 2019 Jolla Ltd.
+ * Copyright (c) 2019 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef CERTIFICATEMODEL_P_H
+#define CERTIFICATEMODEL_P_H
+
+#include "certificatemodel.h"
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QExplicitlySharedDataPointer>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QMutex>
+#include <QSharedData>
+#include <QSharedPointer>
+#include <QTimer>
+
+class CertificateBundle;
+
+// The certificates of the files of a directory bundle by canonical path, so that the files
+// unchanged since the previous load are not parsed again. Held under the mutex for a whole
+// read of the directory, which replaces the entries and so drops those of removed files.
+struct CertificateDirectoryCache
+{
+    struct File
+    {
+        qint64 modified;
+        qint64 changed;
+        quint64 inode;
+        qint64 size;
+        QList<Certificate> certificates;
+    };
+
+    QMutex mutex;
+    QHash<QString, File> files;
+};
+
+// State shared between a bundle and its loading tasks, which may outlive the bundle.
+// The owner is cleared under the mutex when the bundle is destroyed, and the tasks
+// hold the mutex while posting to it.
+struct CertificateLoadState
+{
+    QMutex mutex;
+    CertificateBundle *owner;
+    QAtomicInt generation;
+    CertificateDirectoryCache directoryCache;
+};
+
+// A parsed certificate bundle shared by all the models in the process showing it
+class CertificateBundle : public QObject, public QSharedData
+{
+    Q_OBJECT
+public:
+    ~CertificateBundle();
+
+    static QExplicitlySharedDataPointer<CertificateBundle> instance(const QString &path);
+
+    QString path() const;
+
+    // Sorted by primary and secondary name
+    QList<Certificate> certificates() const;
+
+    void load(bool asynchronous);
+    // Loads without the certificate cache, this and any later loads of the bundle
+    void loadUncached();
+
+    bool isLoading() const;
+    qreal progress() const;
+
+    bool containsFingerprint(const QByteArray &fingerprint) const;
+    QList<Certificate> certificatesWithSubjectNameHash(quint32 hash) const;
+    bool findIssuer(const Certificate &certificate, Certificate *issuer) const;
+
+    // Certificates with notValidAfter in [from, to), an invalid bound is open
+    QList<Certificate> certificatesExpiringBetween(const QDateTime &from, const QDateTime &to) const;
+    int countExpiringBetween(const QDateTime &from, const QDateTime &to) const;
+    // Certificates with notValidBefore later than time
+    QList<Certificate> certificatesNotValidAt(const QDateTime &time) const;
+
+    bool event(QEvent *event) override;
+
+signals:
+    // Both lists are sorted
+    void certificatesAdded(const QList<Certificate> &certificates);
+    void certificatesRemoved(const QList<Certificate> &certificates);
+    void loadingChanged();
+    void progressChanged();
+
+private slots:
+    void reload();
+
+private:
+    explicit CertificateBundle(const QString &path);
+
+    void startLoad(bool asynchronous);
+    void watchDirectoryFiles();
+    void setCertificates(const QList<Certificate> &certificates);
+    void addCertificates(const QList<Certificate> &certificates);
+    void setLoading(bool loading);
+    void setProgress(qreal progress);
+    void updateIndex() const;
+    void updateValidityIndex() const;
+
+    QString m_path;
+    QList<Certificate> m_certificates;
+    // Certificates of an asynchronous reload, applied as a whole when it finishes
+    QList<Certificate> m_pendingCertificates;
+    QSharedPointer<CertificateLoadState> m_loadState;
+    QFileSystemWatcher m_watcher;
+    QTimer m_reloadTimer;
+    QElapsedTimer m_loadTimer;
+    // Built on the first lookup, SHA-1 and SHA-256 fingerprints share the hash
+    mutable QHash<QByteArray, Certificate> m_fingerprintIndex;
+    mutable QMultiHash<quint32, Certificate> m_subjectIndex;
+    mutable QMultiHash<QByteArray, Certificate> m_keyIdentifierIndex;
+    mutable bool m_indexValid;
+    // Sorted by notValidAfter and notValidBefore respectively, built separately from the
+    // hashes above and kept up to date while an asynchronous load adds certificates
+    mutable QList<Certificate> m_expiryIndex;
+    mutable QList<Certificate> m_validFromIndex;
+    mutable bool m_validityIndexValid;
+    qreal m_progress;
+    bool m_loaded;
+    bool m_loading;
+    bool m_asynchronous;
+    bool m_replacing;
+    bool m_uncached;
+};
+
+#endif
@@ -35,3 +35,5 @@ Q_LOGGING_CATEGORY(lcDeveloperModeLog, "org.sailfishos.settings.developermode",
 Q_LOGGING_CATEGORY(lcMemoryCardLog, "org.sailfishos.settings.memorycard", QtWarningMsg)
 Q_LOGGING_CATEGORY(lcMemoryCardDBusLog, "org.sailfishos.settings.memorycard.dbus", QtCriticalMsg)
 Q_LOGGING_CATEGORY(lcUsersLog, "org.sailfishos.settings.users", QtWarningMsg)
+Q_LOGGING_CATEGORY(lcCertificatesLog, "org.sailfishos.settings.certificates", QtWarningMsg)
+Q_LOGGING_CATEGORY(lcCertificatesTimingLog, "org.sailfishos.settings.certificates.timing", QtWarningMsg)
@@ -38,5 +38,7 @@ Q_DECLARE_LOGGING_CATEGORY(lcDeveloperModeLog)
 Q_DECLARE_LOGGING_CATEGORY(lcMemoryCardLog)
 Q_DECLARE_LOGGING_CATEGORY(lcMemoryCardDBusLog)
 Q_DECLARE_LOGGING_CATEGORY(lcUsersLog)
+Q_DECLARE_LOGGING_CATEGORY(lcCertificatesLog)
+Q_DECLARE_LOGGING_CATEGORY(lcCertificatesTimingLog)
 
 #endif
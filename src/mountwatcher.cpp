@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "mountwatcher_p.h"
+#include "logging_p.h"
+
+#include <QSocketNotifier>
+
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+const char *const MountInfoPath = "/proc/self/mountinfo";
+
+// Mountinfo escapes space, tab, newline and backslash as octal sequences
+QString unescape(const QByteArray &field)
+{
+    if (!field.contains('\\')) {
+        return QString::fromUtf8(field);
+    }
+
+    QByteArray unescaped;
+    unescaped.reserve(field.size());
+    for (int i = 0; i < field.size(); ++i) {
+        if (field.at(i) == '\\' && i + 3 < field.size()
+                && field.at(i + 1) >= '0' && field.at(i + 1) <= '3'
+                && field.at(i + 2) >= '0' && field.at(i + 2) <= '7'
+                && field.at(i + 3) >= '0' && field.at(i + 3) <= '7') {
+            unescaped.append(char(((field.at(i + 1) - '0') << 6) | ((field.at(i + 2) - '0') << 3) | (field.at(i + 3) - '0')));
+            i += 3;
+        } else {
+            unescaped.append(field.at(i));
+        }
+    }
+    return QString::fromUtf8(unescaped);
+}
+
+// The position in the table is not compared, it shifts as other mounts come and go
+bool operator!=(const MountEntry &lhs, const MountEntry &rhs)
+{
+    return lhs.devicePath != rhs.devicePath
+            || lhs.mountPath != rhs.mountPath
+            || lhs.filesystemType != rhs.filesystemType;
+}
+
+}
+
+MountWatcher::MountWatcher(QObject *parent)
+    : QObject(parent)
+    , m_fd(::open(MountInfoPath, O_RDONLY | O_CLOEXEC))
+    , m_notifier(nullptr)
+{
+    if (m_fd < 0) {
+        qCWarning(lcMemoryCardLog) << "Unable to open" << MountInfoPath << strerror(errno);
+        return;
+    }
+
+    // The kernel flags the mount table with POLLPRI when it changes
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Exception, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &MountWatcher::update);
+
+    QHash<QString, MountEntry> mounts;
+    if (read(&mounts)) {
+        m_mounts = mounts;
+        for (auto it = m_mounts.cbegin(); it != m_mounts.cend(); ++it) {
+            m_deviceMounts.insert(it->devicePath, it.key());
+        }
+    }
+}
+
+MountWatcher::~MountWatcher()
+{
+    delete m_notifier;
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+bool MountWatcher::mountAt(const QString &mountPath, MountEntry *entry) const
+{
+    auto it = m_mounts.constFind(mountPath);
+    if (it == m_mounts.constEnd()) {
+        return false;
+    }
+    *entry = *it;
+    return true;
+}
+
+bool MountWatcher::mountOf(const QString &devicePath, MountEntry *entry) const
+{
+    bool found = false;
+    for (auto it = m_deviceMounts.constFind(devicePath); it != m_deviceMounts.constEnd() && it.key() == devicePath; ++it) {
+        auto mount = m_mounts.constFind(*it);
+        if (mount != m_mounts.constEnd() && (!found || mount->sequence > entry->sequence)) {
+            *entry = *mount;
+            found = true;
+        }
+    }
+    return found;
+}
+
+void MountWatcher::update()
+{
+    QHash<QString, MountEntry> mounts;
+    if (!read(&mounts)) {
+        return;
+    }
+
+    QList<MountEntry> added;
+    QList<MountEntry> removed;
+    for (auto it = mounts.cbegin(); it != mounts.cend(); ++it) {
+        auto previous = m_mounts.constFind(it.key());
+        if (previous == m_mounts.constEnd()) {
+            added.append(*it);
+        } else if (*previous != *it) {
+            removed.append(*previous);
+            added.append(*it);
+        }
+    }
+    for (auto it = m_mounts.cbegin(); it != m_mounts.cend(); ++it) {
+        if (!mounts.contains(it.key())) {
+            removed.append(*it);
+        }
+    }
+
+    if (added.isEmpty() && removed.isEmpty()) {
+        return;
+    }
+
+    for (const MountEntry &entry : removed) {
+        m_deviceMounts.remove(entry.devicePath, entry.mountPath);
+    }
+    for (const MountEntry &entry : added) {
+        m_deviceMounts.insert(entry.devicePath, entry.mountPath);
+    }
+    m_mounts = mounts;
+
+    qCDebug(lcMemoryCardLog) << "Mount table changed," << added.count() << "added" << removed.count() << "removed";
+    emit mountsChanged(added, removed);
+}
+
+bool MountWatcher::read(QHash<QString, MountEntry> *mounts)
+{
+    // Reading the table from the start also clears the change notification
+    if (::lseek(m_fd, 0, SEEK_SET) < 0) {
+        qCWarning(lcMemoryCardLog) << "Unable to rewind" << MountInfoPath << strerror(errno);
+        return false;
+    }
+
+    QByteArray content;
+    char buffer[16384];
+    for (;;) {
+        const ssize_t count = ::read(m_fd, buffer, sizeof(buffer));
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            qCWarning(lcMemoryCardLog) << "Unable to read" << MountInfoPath << strerror(errno);
+            return false;
+        } else if (count == 0) {
+            break;
+        }
+        content.append(buffer, count);
+    }
+
+    // "36 35 98:0 /mnt1 /mnt/parent rw,noatime master:1 - ext3 /dev/root rw,errors=continue"
+    int sequence = 0;
+    int lineStart = 0;
+    while (lineStart < content.size()) {
+        int lineEnd = content.indexOf('\n', lineStart);
+        if (lineEnd < 0) {
+            lineEnd = content.size();
+        }
+
+        const QList<QByteArray> fields(content.mid(lineStart, lineEnd - lineStart).split(' '));
+        const int separator = fields.indexOf("-");
+        if (separator >= 5 && separator + 2 < fields.count()) {
+            MountEntry entry;
+            entry.mountPath = unescape(fields.at(4));
+            entry.filesystemType = unescape(fields.at(separator + 1));
+            entry.devicePath = unescape(fields.at(separator + 2));
+            entry.sequence = sequence++;
+
+            // Later entries are mounted on top of the earlier ones at the same path
+            mounts->insert(entry.mountPath, entry);
+        }
+
+        lineStart = lineEnd + 1;
+    }
+
+    return true;
+}
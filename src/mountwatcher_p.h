@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef MOUNTWATCHER_P_H
+#define MOUNTWATCHER_P_H
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+
+class QSocketNotifier;
+
+struct MountEntry
+{
+    QString devicePath;
+    QString mountPath;
+    QString filesystemType;
+    // The position in the mount table, later mounts come after earlier ones
+    int sequence = 0;
+};
+
+// Tracks the mount table of the process, it is parsed again only when the kernel signals a change
+class MountWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MountWatcher(QObject *parent = nullptr);
+    ~MountWatcher();
+
+    // The topmost mount at the given path
+    bool mountAt(const QString &mountPath, MountEntry *entry) const;
+    // A mount of the given device, preferring the most recent one
+    bool mountOf(const QString &devicePath, MountEntry *entry) const;
+
+signals:
+    void mountsChanged(const QList<MountEntry> &added, const QList<MountEntry> &removed);
+
+private slots:
+    void update();
+
+private:
+    bool read(QHash<QString, MountEntry> *mounts);
+
+    int m_fd;
+    QSocketNotifier *m_notifier;
+    QHash<QString, MountEntry> m_mounts;
+    // Mount paths by device
+    QMultiHash<QString, QString> m_deviceMounts;
+};
+
+#endif
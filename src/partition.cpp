@@ -66,6 +66,11 @@ bool Partition::operator !=(const Partition &partition) const
     return d != partition.d;
 }
 
+uint qHash(const Partition &partition, uint seed)
+{
+    return qHash(partition.d.data(), seed);
+}
+
 bool Partition::isReadOnly() const
 {
     return !d || d->readOnly;
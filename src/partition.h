@@ -39,6 +39,11 @@
 
 class PartitionPrivate;
 
+class Partition;
+
+// Hashes the identity of the partition, matching operator ==
+SYSTEMSETTINGS_EXPORT uint qHash(const Partition &partition, uint seed = 0);
+
 class SYSTEMSETTINGS_EXPORT Partition
 {
 public:
@@ -132,6 +137,7 @@ public:
 
 private:
     friend class PartitionManagerPrivate;
+    friend SYSTEMSETTINGS_EXPORT uint qHash(const Partition &partition, uint seed);
 
     explicit Partition(const QExplicitlySharedDataPointer<PartitionPrivate> &d);
 
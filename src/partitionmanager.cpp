@@ -35,18 +35,23 @@
 #include "udisks2blockdevices_p.h"
 #include "logging_p.h"
 
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
 #include <QRegularExpression>
 #include <QRunnable>
+#include <QSet>
 #include <QThreadPool>
 #include <QEvent>
 #include <QCoreApplication>
+#include <QDateTime>
 
 #include <algorithm>
 #include <blkid/blkid.h>
 #include <limits>
-#include <linux/limits.h>
-#include <mntent.h>
+#include <sys/stat.h>
 #include <sys/statvfs.h>
 #include <sys/quota.h>
 #include <unistd.h>
@@ -55,73 +60,168 @@ static const auto userName = QString(qgetenv("USER"));
 
 static const QEvent::Type RefreshFinishedEvent = QEvent::Type(QEvent::User + 1);
 
+// Bounds of the interval between free space samples of watched filesystems
+static const int MinimumFreeSpaceInterval = 1000;
+static const int MaximumFreeSpaceInterval = 60 * 1000;
+// Free space read by a refresh this recently is used by the watches without a stat of their own
+static const int FreshFreeSpaceAge = MinimumFreeSpaceInterval;
+
 class RefreshEvent : public QEvent
 {
 public:
-    RefreshEvent(const PartitionManagerPrivate::PartitionList &partitions)
-        : QEvent(RefreshFinishedEvent), m_partitions(partitions)
+    RefreshEvent(const PartitionManagerPrivate::PartitionList &partitions, const QStringList &mountPaths,
+                 bool checkFreeSpace)
+        : QEvent(RefreshFinishedEvent)
+        , m_partitions(partitions)
+        , m_mountPaths(mountPaths)
+        , m_checkFreeSpace(checkFreeSpace)
     {
     }
 
     PartitionManagerPrivate::PartitionList m_partitions;
+    // The mount paths whose free space was read
+    QStringList m_mountPaths;
+    bool m_checkFreeSpace;
 };
 
 class StatTask : public QRunnable
 {
 public:
-    StatTask(PartitionManagerPrivate *owner, const PartitionManagerPrivate::PartitionList &partitions)
-        : m_owner(owner), m_partitions(partitions)
+    StatTask(PartitionManagerPrivate *owner, const PartitionManagerPrivate::PartitionList &partitions,
+             bool checkFreeSpace = false)
+        : m_owner(owner), m_partitions(partitions), m_checkFreeSpace(checkFreeSpace)
     {
     }
 
     void run() override
     {
         PartitionManagerPrivate::PartitionList changedPartitions;
+        QStringList mountPaths;
+
+        struct FileSystemStat
+        {
+            bool valid;
+            qint64 bytesFree;
+            qint64 bytesAvailable;
+            qint64 bytesTotal;
+            bool readOnly;
+        };
+
+        // Partitions on the same filesystem, such as bind mounts, are stat'ed only once
+        QHash<dev_t, FileSystemStat> fileSystems;
+        int statCount = 0;
+        int statvfsCount = 0;
+        int quotactlCount = 0;
 
         for (auto partition : m_partitions) {
-            qint64 quotaAvailable = std::numeric_limits<qint64>::max();
-            struct if_dqblk quota = {};
-
-            if (::quotactl(QCMD(Q_GETQUOTA, USRQUOTA), partition->devicePath.toUtf8().constData(),
-                           ::getuid(), (caddr_t)&quota) == 0
-                    && quota.dqb_bsoftlimit != 0) {
-                quotaAvailable = std::max(static_cast<qint64>(dbtob(quota.dqb_bsoftlimit))
-                                          - static_cast<qint64>(quota.dqb_curspace),
-                                          0LL);
+            const QByteArray mountPath = partition->mountPath.toUtf8();
+
+            struct stat64 fileStat;
+            ++statCount;
+            if (::stat64(mountPath.constData(), &fileStat) != 0) {
+                continue;
             }
 
-            struct statvfs64 stat;
-            if (::statvfs64(partition->mountPath.toUtf8().constData(), &stat) == 0) {
-                qint64 bytesFree = stat.f_bfree * stat.f_frsize;
-                qint64 bytesAvailable = std::min((qint64)(stat.f_bavail * stat.f_frsize), quotaAvailable);
+            auto it = fileSystems.find(fileStat.st_dev);
+            if (it == fileSystems.end()) {
+                FileSystemStat fileSystem = { false, 0, 0, 0, true };
+
+                qint64 quotaAvailable = std::numeric_limits<qint64>::max();
+                if (quotaSupported(partition->devicePath, mountPath)) {
+                    struct if_dqblk quota = {};
+
+                    ++quotactlCount;
+                    if (::quotactl(QCMD(Q_GETQUOTA, USRQUOTA), partition->devicePath.toUtf8().constData(),
+                                   ::getuid(), (caddr_t)&quota) == 0) {
+                        if (quota.dqb_bsoftlimit != 0) {
+                            quotaAvailable = std::max(static_cast<qint64>(dbtob(quota.dqb_bsoftlimit))
+                                                      - static_cast<qint64>(quota.dqb_curspace),
+                                                      0LL);
+                        }
+                    } else {
+                        setQuotaUnsupported(partition->devicePath, mountPath);
+                    }
+                }
+
+                struct statvfs64 stat;
+                ++statvfsCount;
+                if (::statvfs64(mountPath.constData(), &stat) == 0) {
+                    fileSystem.valid = true;
+                    fileSystem.bytesFree = stat.f_bfree * stat.f_frsize;
+                    fileSystem.bytesAvailable = std::min((qint64)(stat.f_bavail * stat.f_frsize), quotaAvailable);
+                    fileSystem.bytesTotal = stat.f_blocks * stat.f_frsize;
+                    fileSystem.readOnly = (stat.f_flag & ST_RDONLY) != 0;
+                }
+
+                it = fileSystems.insert(fileStat.st_dev, fileSystem);
+            }
 
-                if (partition->bytesFree != bytesFree || partition->bytesAvailable != bytesAvailable) {
+            if (it->valid) {
+                if (partition->bytesFree != it->bytesFree || partition->bytesAvailable != it->bytesAvailable) {
                     changedPartitions.append(partition);
                 }
-                partition->bytesFree = bytesFree;
-                partition->bytesAvailable = bytesAvailable;
-                partition->bytesTotal = stat.f_blocks * stat.f_frsize;
-                partition->readOnly = (stat.f_flag & ST_RDONLY) != 0;
+                partition->bytesFree = it->bytesFree;
+                partition->bytesAvailable = it->bytesAvailable;
+                partition->bytesTotal = it->bytesTotal;
+                partition->readOnly = it->readOnly;
+                mountPaths.append(partition->mountPath);
             }
         }
 
+        qCDebug(lcMemoryCardLog, "Stat pass: partitions=%d filesystems=%d stat=%d statvfs=%d quotactl=%d",
+                m_partitions.count(), fileSystems.count(), statCount, statvfsCount, quotactlCount);
+
         if (m_owner) {
-            QCoreApplication::postEvent(m_owner, new RefreshEvent(changedPartitions));
+            QCoreApplication::postEvent(m_owner, new RefreshEvent(changedPartitions, mountPaths, m_checkFreeSpace));
         }
     }
 
+    // Forgets the filesystems found not to have quotas enabled, they may have been remounted
+    static void resetQuotaSupport()
+    {
+        QMutexLocker locker(&quotaMutex);
+        unsupportedQuotas.clear();
+    }
+
 private:
+    static bool quotaSupported(const QString &devicePath, const QByteArray &mountPath)
+    {
+        QMutexLocker locker(&quotaMutex);
+        return !unsupportedQuotas.contains(qMakePair(devicePath, mountPath));
+    }
+
+    static void setQuotaUnsupported(const QString &devicePath, const QByteArray &mountPath)
+    {
+        QMutexLocker locker(&quotaMutex);
+        unsupportedQuotas.insert(qMakePair(devicePath, mountPath));
+    }
+
+    static QMutex quotaMutex;
+    static QSet<QPair<QString, QByteArray>> unsupportedQuotas;
+
     QPointer<PartitionManagerPrivate> m_owner;
     PartitionManagerPrivate::PartitionList m_partitions;
+    bool m_checkFreeSpace;
 };
 
+QMutex StatTask::quotaMutex;
+QSet<QPair<QString, QByteArray>> StatTask::unsupportedQuotas;
+
 PartitionManagerPrivate *PartitionManagerPrivate::sharedInstance = nullptr;
 
 PartitionManagerPrivate::PartitionManagerPrivate()
+    : m_fileSystemsValid(false)
+    , m_nextFreeSpaceWatchId(1)
 {
     Q_ASSERT(!sharedInstance);
 
     sharedInstance = this;
+    connect(&m_mountWatcher, &MountWatcher::mountsChanged, this, &PartitionManagerPrivate::mountsChanged);
+
+    // Installing or removing filesystem tools updates the format types
+    updateFormatTypes();
+    m_toolWatcher.addPath(QStringLiteral("/sbin"));
+    connect(&m_toolWatcher, &QFileSystemWatcher::directoryChanged, this, &PartitionManagerPrivate::updateFormatTypes);
     m_udisksMonitor.reset(new UDisks2::Monitor(this));
     connect(m_udisksMonitor.data(), &UDisks2::Monitor::status, this, &PartitionManagerPrivate::status);
     connect(m_udisksMonitor.data(), &UDisks2::Monitor::errorMessage, this, &PartitionManagerPrivate::errorMessage);
@@ -189,6 +289,10 @@ PartitionManagerPrivate::PartitionManagerPrivate()
     m_refreshTimer.setInterval(10);
     connect(&m_refreshTimer, SIGNAL(timeout()),
             this, SLOT(refresh()));
+
+    m_freeSpaceTimer.setSingleShot(true);
+    m_freeSpaceTimer.setInterval(MinimumFreeSpaceInterval);
+    connect(&m_freeSpaceTimer, &QTimer::timeout, this, &PartitionManagerPrivate::statWatchedPartitions);
 }
 
 PartitionManagerPrivate::~PartitionManagerPrivate()
@@ -307,49 +411,36 @@ void PartitionManagerPrivate::refresh(const PartitionList &partitions)
         }
     }
 
-    FILE *mtab = setmntent("/etc/mtab", "r");
-    mntent mountEntry;
-    char buffer[3 * PATH_MAX];
-
-    while (getmntent_r(mtab, &mountEntry, buffer, sizeof(buffer))) {
-        if (!mountEntry.mnt_fsname || !mountEntry.mnt_dir) {
+    for (auto partition : partitions) {
+        if (partition->valid
+                || ((partition->status == Partition::Mounted || partition->status == Partition::Mounting)
+                    && (partition->storageType != Partition::External))) {
             continue;
         }
 
-        const QString mountPath = QString::fromUtf8(mountEntry.mnt_dir);
-        const QString devicePath = QString::fromUtf8(mountEntry.mnt_fsname);
-        const QString deviceName = devicePath.section(QChar('/'), 2);
-
-        for (auto partition : partitions) {
-            if (partition->valid
-                    || ((partition->status == Partition::Mounted || partition->status == Partition::Mounting)
-                        && (partition->storageType != Partition::External))) {
-                continue;
-            }
-
-            if (((partition->storageType & Partition::Internal)
-                            && partition->mountPath == mountPath
-                            && devicePath.startsWith(QLatin1Char('/')))
-                    || (partition->storageType == Partition::External
-                            && partition->devicePath == devicePath)) {
-                partition->mountPath = mountPath;
-                partition->devicePath = devicePath;
-                // There two values wrong for system partitions as devicePath will not start with mmcblk.
-                // Currently deviceName and deviceRoot are merely informative data fields.
-                partition->deviceName = deviceName;
-                partition->deviceRoot = deviceRoot.match(deviceName).hasMatch();
-                partition->filesystemType = QString::fromUtf8(mountEntry.mnt_type);
-                partition->isSupportedFileSystemType = supportedFileSystems().contains(partition->filesystemType);
-                partition->status = partition->activeState == QStringLiteral("deactivating")
-                        ? Partition::Unmounting
-                        : Partition::Mounted;
-                partition->canMount = true;
-            }
+        MountEntry mountEntry;
+        if (((partition->storageType & Partition::Internal)
+                        && m_mountWatcher.mountAt(partition->mountPath, &mountEntry)
+                        && mountEntry.devicePath.startsWith(QLatin1Char('/')))
+                || (partition->storageType == Partition::External
+                        && m_mountWatcher.mountOf(partition->devicePath, &mountEntry))) {
+            const QString deviceName = mountEntry.devicePath.section(QChar('/'), 2);
+
+            partition->mountPath = mountEntry.mountPath;
+            partition->devicePath = mountEntry.devicePath;
+            // There two values wrong for system partitions as devicePath will not start with mmcblk.
+            // Currently deviceName and deviceRoot are merely informative data fields.
+            partition->deviceName = deviceName;
+            partition->deviceRoot = deviceRoot.match(deviceName).hasMatch();
+            partition->filesystemType = mountEntry.filesystemType;
+            partition->isSupportedFileSystemType = isSupportedFileSystem(partition->filesystemType);
+            partition->status = partition->activeState == QStringLiteral("deactivating")
+                    ? Partition::Unmounting
+                    : Partition::Mounted;
+            partition->canMount = true;
         }
     }
 
-    endmntent(mtab);
-
     PartitionList partitionsToStat;
 
     for (auto partition : partitions) {
@@ -364,6 +455,36 @@ void PartitionManagerPrivate::refresh(const PartitionList &partitions)
     }
 }
 
+void PartitionManagerPrivate::mountsChanged(const QList<MountEntry> &added, const QList<MountEntry> &removed)
+{
+    // Mounting may have loaded a filesystem module or enabled quotas
+    m_fileSystemsValid = false;
+    StatTask::resetQuotaSupport();
+
+    QSet<QString> paths;
+    for (const MountEntry &entry : added + removed) {
+        paths.insert(entry.mountPath);
+        paths.insert(entry.devicePath);
+        m_freeSpaceTimes.remove(entry.mountPath);
+    }
+
+    // Only the partitions tracked through the mount table are affected, udisks reports on the others
+    PartitionList changedPartitions;
+    for (auto partition : m_partitions) {
+        if (!partition->valid && (paths.contains(partition->mountPath) || paths.contains(partition->devicePath))) {
+            changedPartitions.append(partition);
+        }
+    }
+
+    if (!changedPartitions.isEmpty()) {
+        refresh(changedPartitions);
+
+        for (const auto partition : changedPartitions) {
+            emit partitionChanged(Partition(partition));
+        }
+    }
+}
+
 bool PartitionManagerPrivate::isActionAllowed(const QString &devicePath, const QString &action)
 {
     qCInfo(lcMemoryCardLog) << "Is auto:" << UDisks2::BlockDevices::instance()->hintAuto(devicePath);
@@ -417,19 +538,174 @@ QString PartitionManagerPrivate::objectPath(const QString &devicePath) const
 
 QStringList PartitionManagerPrivate::supportedFileSystems() const
 {
+    updateFileSystems();
+    return m_fileSystems;
+}
+
+bool PartitionManagerPrivate::isSupportedFileSystem(const QString &filesystemType) const
+{
+    updateFileSystems();
+    return m_fileSystemSet.contains(filesystemType);
+}
+
+void PartitionManagerPrivate::updateFileSystems() const
+{
+    if (m_fileSystemsValid) {
+        return;
+    }
+
     // Query filesystems supported by this device
     // Note this will only find filesystems supported either directly by the
     // kernel, or by modules already loaded.
-    QStringList supportedFs;
+    m_fileSystems.clear();
     QFile filesystems(QStringLiteral("/proc/filesystems"));
     if (filesystems.open(QIODevice::ReadOnly)) {
         QString line = filesystems.readLine();
         while (line.length() > 0) {
-            supportedFs << line.trimmed().split('\t').last();
+            m_fileSystems << line.trimmed().split('\t').last();
             line = filesystems.readLine();
         }
     }
-    return supportedFs;
+    m_fileSystemSet = QSet<QString>::fromList(m_fileSystems);
+    m_fileSystemsValid = true;
+}
+
+QStringList PartitionManagerPrivate::supportedFormatTypes() const
+{
+    return m_formatTypes;
+}
+
+void PartitionManagerPrivate::updateFormatTypes()
+{
+    QStringList types;
+    QDir dir("/sbin/");
+    QStringList entries = dir.entryList(QStringList() << QString("mkfs.*"));
+    for (const QString &entry : entries) {
+        QFileInfo info(QString("/sbin/%1").arg(entry));
+        if (info.exists() && info.isExecutable()) {
+            QStringList parts = entry.split('.');
+            if (!parts.isEmpty()) {
+                types << parts.takeLast();
+            }
+        }
+    }
+
+    if (m_formatTypes != types) {
+        m_formatTypes = types;
+        emit supportedFormatTypesChanged();
+    }
+}
+
+int PartitionManagerPrivate::addFreeSpaceWatch(const QString &path, qint64 threshold)
+{
+    const int watchId = m_nextFreeSpaceWatchId++;
+    m_freeSpaceWatches.insert(watchId, FreeSpaceWatch { path, threshold, false });
+
+    // Sample the new watch promptly
+    m_freeSpaceTimer.start(MinimumFreeSpaceInterval);
+    return watchId;
+}
+
+void PartitionManagerPrivate::removeFreeSpaceWatch(int watchId)
+{
+    m_freeSpaceWatches.remove(watchId);
+    if (m_freeSpaceWatches.isEmpty()) {
+        m_freeSpaceTimer.stop();
+        m_freeSpaceSamples.clear();
+    }
+}
+
+QExplicitlySharedDataPointer<PartitionPrivate> PartitionManagerPrivate::partitionFor(const QString &path) const
+{
+    // The mounted partition with the longest mount path containing the path
+    QExplicitlySharedDataPointer<PartitionPrivate> match;
+    for (const auto partition : m_partitions) {
+        if (partition->status != Partition::Mounted || partition->mountPath.isEmpty()
+                || (match && match->mountPath.length() >= partition->mountPath.length())) {
+            continue;
+        }
+
+        const QString &mountPath = partition->mountPath;
+        if (path == mountPath
+                || (path.startsWith(mountPath)
+                    && (mountPath.endsWith(QLatin1Char('/')) || path.at(mountPath.length()) == QLatin1Char('/')))) {
+            match = partition;
+        }
+    }
+    return match;
+}
+
+void PartitionManagerPrivate::statWatchedPartitions()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    // Watches on the same filesystem share a single stat, and a refresh that has just
+    // read the free space saves it altogether
+    PartitionList partitionsToStat;
+    bool watched = false;
+    for (const FreeSpaceWatch &watch : m_freeSpaceWatches) {
+        const auto partition = partitionFor(watch.path);
+        if (!partition) {
+            continue;
+        }
+        watched = true;
+        if (now - m_freeSpaceTimes.value(partition->mountPath, 0) >= FreshFreeSpaceAge
+                && !partitionsToStat.contains(partition)) {
+            partitionsToStat.append(partition);
+        }
+    }
+
+    for (auto &partition : partitionsToStat) {
+        partition.detach(); // we don't want to share instances over threads
+    }
+
+    if (!partitionsToStat.isEmpty()) {
+        QThreadPool::globalInstance()->start(new StatTask(this, partitionsToStat, true));
+    } else if (watched) {
+        checkFreeSpaceWatches();
+    } else if (!m_freeSpaceWatches.isEmpty()) {
+        m_freeSpaceTimer.start(MaximumFreeSpaceInterval);
+    }
+}
+
+void PartitionManagerPrivate::checkFreeSpaceWatches()
+{
+    if (m_freeSpaceWatches.isEmpty()) {
+        return;
+    }
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    int interval = qMin(m_freeSpaceTimer.interval() * 2, MaximumFreeSpaceInterval);
+
+    QHash<QString, FreeSpaceSample> samples;
+    for (auto it = m_freeSpaceWatches.begin(); it != m_freeSpaceWatches.end(); ++it) {
+        const auto partition = partitionFor(it->path);
+        if (!partition || partition->bytesAvailable < 0) {
+            continue;
+        }
+
+        const qint64 bytesAvailable = partition->bytesAvailable;
+        const bool low = bytesAvailable < it->threshold;
+        if (it->low != low) {
+            it->low = low;
+            emit freeSpaceThresholdCrossed(it.key(), low, bytesAvailable);
+        }
+
+        // Sample more often while the free space is changing, the sooner the threshold
+        // could be crossed at the current rate the shorter the interval
+        const FreeSpaceSample previous = m_freeSpaceSamples.value(partition->mountPath, FreeSpaceSample { bytesAvailable, now });
+        if (previous.bytesAvailable != bytesAvailable) {
+            const qint64 elapsed = qMax<qint64>(now - previous.time, 1);
+            const qint64 rate = qAbs(bytesAvailable - previous.bytesAvailable) / elapsed;
+            const qint64 distance = qAbs(bytesAvailable - it->threshold);
+            const qint64 eta = rate > 0 ? distance / rate : MaximumFreeSpaceInterval;
+            interval = qMin<qint64>(interval, qMin<qint64>(m_freeSpaceTimer.interval() / 2, eta / 4));
+        }
+        samples.insert(partition->mountPath, FreeSpaceSample { bytesAvailable, now });
+    }
+    m_freeSpaceSamples = samples;
+
+    m_freeSpaceTimer.start(qBound(MinimumFreeSpaceInterval, interval, MaximumFreeSpaceInterval));
 }
 
 bool PartitionManagerPrivate::externalStoragesPopulated() const
@@ -440,7 +716,13 @@ bool PartitionManagerPrivate::externalStoragesPopulated() const
 bool PartitionManagerPrivate::event(QEvent *event)
 {
     if (event->type() == RefreshFinishedEvent) {
-        PartitionList partitions = static_cast<RefreshEvent*>(event)->m_partitions;
+        const RefreshEvent *refreshEvent = static_cast<RefreshEvent*>(event);
+        PartitionList partitions = refreshEvent->m_partitions;
+
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+        for (const QString &mountPath : refreshEvent->m_mountPaths) {
+            m_freeSpaceTimes.insert(mountPath, now);
+        }
 
         for (auto partition : partitions) {
             for (auto ownPartition : m_partitions) {
@@ -470,6 +752,11 @@ bool PartitionManagerPrivate::event(QEvent *event)
             }
         }
 
+        // Refreshes only update the free space, the watches are checked on their own timer
+        if (refreshEvent->m_checkFreeSpace) {
+            checkFreeSpaceWatches();
+        }
+
         return true;
     }
 
@@ -485,10 +772,23 @@ PartitionManager::PartitionManager(QObject *parent)
     connect(d.data(), &PartitionManagerPrivate::partitionRemoved, this, &PartitionManager::partitionRemoved);
     connect(d.data(), &PartitionManagerPrivate::externalStoragesPopulatedChanged,
             this, &PartitionManager::externalStoragesPopulated);
+    connect(d.data(), &PartitionManagerPrivate::freeSpaceThresholdCrossed,
+            this, [this](int watchId, bool low, qint64 bytesAvailable) {
+        if (m_freeSpaceWatches.contains(watchId)) {
+            if (low) {
+                emit freeSpaceLow(watchId, bytesAvailable);
+            } else {
+                emit freeSpaceRestored(watchId, bytesAvailable);
+            }
+        }
+    });
 }
 
 PartitionManager::~PartitionManager()
 {
+    for (int watchId : m_freeSpaceWatches) {
+        d->removeFreeSpaceWatch(watchId);
+    }
 }
 
 Partition PartitionManager::root() const
@@ -505,3 +805,17 @@ void PartitionManager::refresh()
 {
     d->scheduleRefresh();
 }
+
+int PartitionManager::addFreeSpaceWatch(const QString &path, qint64 threshold)
+{
+    const int watchId = d->addFreeSpaceWatch(path, threshold);
+    m_freeSpaceWatches.insert(watchId);
+    return watchId;
+}
+
+void PartitionManager::removeFreeSpaceWatch(int watchId)
+{
+    if (m_freeSpaceWatches.remove(watchId)) {
+        d->removeFreeSpaceWatch(watchId);
+    }
+}
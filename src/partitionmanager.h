@@ -33,6 +33,7 @@
 #define PARTITIONMANAGER_H
 
 #include <QObject>
+#include <QSet>
 
 #include <partition.h>
 
@@ -50,14 +51,23 @@ public:
 
     void refresh();
 
+    // Watches the bytes available on the filesystem holding path. freeSpaceLow() is emitted when
+    // they fall below the threshold and freeSpaceRestored() when they reach it again.
+    // The filesystems are sampled more often while their free space is changing.
+    int addFreeSpaceWatch(const QString &path, qint64 threshold);
+    void removeFreeSpaceWatch(int watchId);
+
 signals:
     void partitionChanged(const Partition &partition);
     void partitionAdded(const Partition &partition);
     void partitionRemoved(const Partition &partition);
     void externalStoragesPopulated();
+    void freeSpaceLow(int watchId, qint64 bytesAvailable);
+    void freeSpaceRestored(int watchId, qint64 bytesAvailable);
 
 private:
     QExplicitlySharedDataPointer<PartitionManagerPrivate> d;
+    QSet<int> m_freeSpaceWatches;
 };
 
 #endif
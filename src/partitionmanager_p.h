@@ -34,8 +34,12 @@
 
 #include "partitionmanager.h"
 #include "partition_p.h"
+#include "mountwatcher_p.h"
 
+#include <QFileSystemWatcher>
+#include <QHash>
 #include <QMap>
+#include <QSet>
 #include <QVector>
 #include <QScopedPointer>
 #include <QTimer>
@@ -73,7 +77,14 @@ public:
 
     QString objectPath(const QString &devicePath) const;
 
+    int addFreeSpaceWatch(const QString &path, qint64 threshold);
+    void removeFreeSpaceWatch(int watchId);
+
+    // Filesystems known to the kernel, cached until the mount table changes
     QStringList supportedFileSystems() const;
+    bool isSupportedFileSystem(const QString &filesystemType) const;
+    // Filesystems with a mkfs tool installed
+    QStringList supportedFormatTypes() const;
     bool externalStoragesPopulated() const;
 
     bool event(QEvent *event) override;
@@ -86,6 +97,8 @@ signals:
     void partitionAdded(const Partition &partition);
     void partitionRemoved(const Partition &partition);
     void externalStoragesPopulatedChanged();
+    void supportedFormatTypesChanged();
+    void freeSpaceThresholdCrossed(int watchId, bool low, qint64 bytesAvailable);
 
     void status(const QString &deviceName, Partition::Status);
     void errorMessage(const QString &objectPath, const QString &errorName);
@@ -97,12 +110,45 @@ signals:
 
 private:
     bool isActionAllowed(const QString &devicePath, const QString &action);
+    void mountsChanged(const QList<MountEntry> &added, const QList<MountEntry> &removed);
+    void updateFileSystems() const;
+    void updateFormatTypes();
+    QExplicitlySharedDataPointer<PartitionPrivate> partitionFor(const QString &path) const;
+    void statWatchedPartitions();
+    void checkFreeSpaceWatches();
     // TODO: This is leaking (Disks2::Monitor is never free'ed).
     static PartitionManagerPrivate *sharedInstance;
 
     PartitionList m_partitions;
     Partition m_root;
     QTimer m_refreshTimer;
+    MountWatcher m_mountWatcher;
+    QFileSystemWatcher m_toolWatcher;
+    mutable QStringList m_fileSystems;
+    mutable QSet<QString> m_fileSystemSet;
+    mutable bool m_fileSystemsValid;
+    QStringList m_formatTypes;
+
+    struct FreeSpaceWatch
+    {
+        QString path;
+        qint64 threshold;
+        bool low;
+    };
+
+    struct FreeSpaceSample
+    {
+        qint64 bytesAvailable;
+        qint64 time;
+    };
+
+    QHash<int, FreeSpaceWatch> m_freeSpaceWatches;
+    // The latest sample of each watched mount path
+    QHash<QString, FreeSpaceSample> m_freeSpaceSamples;
+    // The time the free space of each mount path was last read
+    QHash<QString, qint64> m_freeSpaceTimes;
+    QTimer m_freeSpaceTimer;
+    int m_nextFreeSpaceWatchId;
 
     QScopedPointer<UDisks2::Monitor> m_udisksMonitor;
 
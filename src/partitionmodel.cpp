@@ -34,8 +34,10 @@
 
 #include "logging_p.h"
 
-#include <QDir>
-#include <QFileInfo>
+#include <QHash>
+#include <QSet>
+
+#include <algorithm>
 
 PartitionModel::PartitionModel(QObject *parent)
     : QAbstractListModel(parent)
@@ -49,6 +51,8 @@ PartitionModel::PartitionModel(QObject *parent)
     connect(m_manager.data(), &PartitionManagerPrivate::partitionRemoved, this, &PartitionModel::partitionRemoved);
     connect(m_manager.data(), &PartitionManagerPrivate::externalStoragesPopulatedChanged,
             this, &PartitionModel::externalStoragesPopulatedChanged);
+    connect(m_manager.data(), &PartitionManagerPrivate::supportedFormatTypesChanged,
+            this, &PartitionModel::supportedFormatTypesChanged);
 
     connect(m_manager.data(), &PartitionManagerPrivate::errorMessage, this, &PartitionModel::errorMessage);
 
@@ -92,20 +96,7 @@ void PartitionModel::setStorageTypes(StorageTypes types)
 
 QStringList PartitionModel::supportedFormatTypes() const
 {
-    QStringList types;
-    QDir dir("/sbin/");
-    QStringList entries = dir.entryList(QStringList() << QString("mkfs.*"));
-    for (const QString &entry : entries) {
-        QFileInfo info(QString("/sbin/%1").arg(entry));
-        if (info.exists() && info.isExecutable()) {
-            QStringList parts = entry.split('.');
-            if (!parts.isEmpty()) {
-                types << parts.takeLast();
-            }
-        }
-    }
-
-    return types;
+    return m_manager->supportedFormatTypes();
 }
 
 bool PartitionModel::externalStoragesPopulated() const
@@ -206,35 +197,76 @@ void PartitionModel::update()
 
     const auto partitions = m_manager->partitions(Partition::StorageTypes(int(m_storageTypes)));
 
-    int index = 0;
+    QSet<Partition> included;
+    included.reserve(partitions.count());
+    for (const auto &partition : partitions) {
+        included.insert(partition);
+    }
+
+    // Remove the partitions no longer included, a contiguous run at a time
+    for (int end = m_partitions.count(); end > 0;) {
+        if (included.contains(m_partitions.at(end - 1))) {
+            --end;
+            continue;
+        }
+
+        int begin = end - 1;
+        while (begin > 0 && !included.contains(m_partitions.at(begin - 1))) {
+            --begin;
+        }
+
+        beginRemoveRows(QModelIndex(), begin, end - 1);
+        m_partitions.remove(begin, end - begin);
+        endRemoveRows();
 
-    for (const auto partition : partitions) {
-        const int existingIndex = [this, index, partition]() {
-            for (int i = index; i < m_partitions.count(); ++i) {
-                if (m_partitions.at(i) == partition) {
-                    return i;
-                }
+        end = begin;
+    }
+
+    // The rows of the remaining partitions, kept up to date as rows are inserted and moved
+    QHash<Partition, int> rows;
+    rows.reserve(m_partitions.count());
+    const auto updateRows = [this, &rows](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            rows.insert(m_partitions.at(i), i);
+        }
+    };
+    updateRows(0, m_partitions.count());
+
+    // The remaining rows keep their relative order unless partitions were reordered,
+    // so rows are only looked up when they have to be moved
+    for (int index = 0; index < partitions.count();) {
+        if (index < m_partitions.count() && m_partitions.at(index) == partitions.at(index)) {
+            ++index;
+        } else if (!rows.contains(partitions.at(index))) {
+            int end = index + 1;
+            while (end < partitions.count() && !rows.contains(partitions.at(end))) {
+                ++end;
             }
-            return -1;
-        }();
 
-        if (existingIndex == -1) {
-            beginInsertRows(QModelIndex(), index, index);
-            m_partitions.insert(index, partition);
+            beginInsertRows(QModelIndex(), index, end - 1);
+            m_partitions.insert(index, end - index, Partition());
+            std::copy(partitions.cbegin() + index, partitions.cbegin() + end, m_partitions.begin() + index);
             endInsertRows();
-        } else if (existingIndex > index) {
-            beginMoveRows(QModelIndex(), existingIndex, existingIndex, QModelIndex(), index);
-            const auto partition = m_partitions.takeAt(existingIndex);
-            m_partitions.insert(index, partition);
+
+            updateRows(end, m_partitions.count());
+            index = end;
+        } else {
+            // The rows before index are in place, so the partition is further down
+            const int from = rows.value(partitions.at(index));
+            int length = 1;
+            while (index + length < partitions.count()
+                   && from + length < m_partitions.count()
+                   && m_partitions.at(from + length) == partitions.at(index + length)) {
+                ++length;
+            }
+
+            beginMoveRows(QModelIndex(), from, from + length - 1, QModelIndex(), index);
+            std::rotate(m_partitions.begin() + index, m_partitions.begin() + from, m_partitions.begin() + from + length);
             endMoveRows();
-        }
-        ++index;
-    }
 
-    if (index < m_partitions.count()) {
-        beginRemoveRows(QModelIndex(), index, m_partitions.count() - 1);
-        m_partitions.resize(index);
-        endRemoveRows();
+            updateRows(index, from + length);
+            index += length;
+        }
     }
 
     if (count != m_partitions.count()) {
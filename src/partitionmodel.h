@@ -44,7 +44,7 @@ class SYSTEMSETTINGS_EXPORT PartitionModel : public QAbstractListModel
     Q_FLAGS(StorageTypes)
     Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
     Q_PROPERTY(StorageTypes storageTypes READ storageTypes WRITE setStorageTypes NOTIFY storageTypesChanged)
-    Q_PROPERTY(QStringList supportedFormatTypes READ supportedFormatTypes CONSTANT)
+    Q_PROPERTY(QStringList supportedFormatTypes READ supportedFormatTypes NOTIFY supportedFormatTypesChanged)
     Q_PROPERTY(bool externalStoragesPopulated READ externalStoragesPopulated NOTIFY externalStoragesPopulatedChanged)
 
 public:
@@ -155,6 +155,7 @@ signals:
     void countChanged();
     void storageTypesChanged();
     void externalStoragesPopulatedChanged();
+    void supportedFormatTypesChanged();
 
     void errorMessage(const QString &objectPath, const QString &errorName);
     void lockError(Error error);
@@ -1,8 +1,9 @@
 TEMPLATE = lib
 TARGET = systemsettings
+isEmpty(VERSION): VERSION = 1.0.0
 
 CONFIG += qt create_pc create_prl no_install_prl
-QT += dbus network
+QT += dbus network concurrent qml
 QT -= gui
 
 CONFIG += hide_symbols link_pkgconfig
@@ -31,6 +32,7 @@ SOURCES += \
     partitionmodel.cpp \
     deviceinfo.cpp \
     locationsettings.cpp \
+    mountwatcher.cpp \
     timezoneinfo.cpp \
     udisks2block.cpp \
     udisks2blockdevices.cpp \
@@ -69,9 +71,11 @@ HEADERS += \
     aboutsettings_p.h \
     localeconfig.h \
     batterystatus_p.h \
+    certificatemodel_p.h \
     logging_p.h \
     locationsettings_p.h \
     logging_p.h \
+    mountwatcher_p.h \
     nfcsettings.h \
     partition_p.h \
     partitionmanager_p.h \
@@ -102,6 +106,6 @@ QMAKE_PKGCONFIG_DESCRIPTION = System settings application development files
 QMAKE_PKGCONFIG_LIBDIR = $$target.path
 QMAKE_PKGCONFIG_INCDIR = $$develheaders.path
 QMAKE_PKGCONFIG_DESTDIR = pkgconfig
-QMAKE_PKGCONFIG_REQUIRES = Qt5Core Qt5DBus
+QMAKE_PKGCONFIG_REQUIRES = Qt5Core Qt5DBus Qt5Concurrent Qt5Qml
 
 INSTALLS += target develheaders pkgconfig locationconfig compat_locationconfig
@@ -13,10 +13,14 @@ public:
         : m_path(path)
         , m_interfacePropertyMap(interfacePropertyMap)
         , m_data(interfacePropertyMap.value(UDISKS2_BLOCK_INTERFACE))
+        , m_drive(interfacePropertyMap.value(UDISKS2_DRIVE_INTERFACE))
         , m_connection(QDBusConnection::systemBus(), lcMemoryCardDBusLog())
         , m_mountable(interfacePropertyMap.contains(UDISKS2_FILESYSTEM_INTERFACE))
         , m_encrypted(interfacePropertyMap.contains(UDISKS2_ENCRYPTED_INTERFACE))
-    {}
+    {
+        // Drive properties may be passed along with the block's own interfaces.
+        m_interfacePropertyMap.remove(UDISKS2_DRIVE_INTERFACE);
+    }
     ~BlockPrivate() {}
 
     QString m_path;
@@ -40,21 +44,13 @@ public:
     bool m_pendingPartitionTable = false;
 };
 
+static int propertyQueries = 0;
+
 UDisks2::Block::Block(const QString &path, const UDisks2::InterfacePropertyMap &interfacePropertyMap, QObject *parent)
     : QObject(parent)
     , d_ptr(new BlockPrivate(path, interfacePropertyMap))
 {
-    if (!d_ptr->m_connection.connectToSignal(
-                UDISKS2_SERVICE,
-                d_ptr->m_path,
-                DBUS_OBJECT_PROPERTIES_INTERFACE,
-                UDisks2::propertiesChangedSignal,
-                this,
-                SLOT(updateProperties(QDBusMessage)))) {
-        qCWarning(lcMemoryCardLog) << "Failed to connect to Block properties change interface" << d_ptr->m_path
-                                   << d_ptr->m_connection.connection().lastError().message();
-    }
-
+    // Property changes are delivered by BlockDevices from the monitor's single subscription.
     qCInfo(lcMemoryCardLog) << "Creating a new block. Mountable:" << d_ptr->m_mountable
                             << ", encrypted:" << d_ptr->m_encrypted
                             << "object path:" << d_ptr->m_path << "data is empty:" << d_ptr->m_data.isEmpty();
@@ -111,12 +107,14 @@ UDisks2::Block::Block(const QString &path, const UDisks2::InterfacePropertyMap &
             updateFileSystemInterface(map);
         }
 
-        getProperties(
-                drive(), UDISKS2_DRIVE_INTERFACE, &d_ptr->m_pendingDrive,
-                [this](const QVariantMap &driveProperties) {
-                    qCInfo(lcMemoryCardLog) << "Drive properties:" << driveProperties;
-                    d_ptr->m_drive = driveProperties;
-                });
+        if (d_ptr->m_drive.isEmpty()) {
+            getProperties(
+                    drive(), UDISKS2_DRIVE_INTERFACE, &d_ptr->m_pendingDrive,
+                    [this](const QVariantMap &driveProperties) {
+                        qCInfo(lcMemoryCardLog) << "Drive properties:" << driveProperties;
+                        d_ptr->m_drive = driveProperties;
+                    });
+        }
 
         complete();
     }
@@ -206,6 +204,18 @@ bool UDisks2::Block::isPartitionTable() const
     return !d_ptr->m_interfacePropertyMap.value(UDISKS2_PARTITION_TABLE_INTERFACE).isEmpty();
 }
 
+QStringList UDisks2::Block::partitions() const
+{
+    const QList<QDBusObjectPath> partitionPaths = NemoDBus::demarshallArgument<QList<QDBusObjectPath> >(
+                d_ptr->m_interfacePropertyMap.value(UDISKS2_PARTITION_TABLE_INTERFACE).value(QStringLiteral("Partitions")));
+
+    QStringList paths;
+    for (const QDBusObjectPath &path : partitionPaths) {
+        paths << path.path();
+    }
+    return paths;
+}
+
 qint64 UDisks2::Block::deviceNumber() const
 {
     return value(QStringLiteral("DeviceNumber")).toLongLong();
@@ -466,6 +476,15 @@ void UDisks2::Block::updateProperties(const QDBusMessage &message)
             // catch here at least if it does something unexpected.
             qWarning() << "FIXME: invalidated udisks2 filesystem properties contained MountPoints";
         }
+    } else if (interface == UDISKS2_PARTITION_TABLE_INTERFACE) {
+        QVariantMap changedProperties = NemoDBus::demarshallArgument<QVariantMap>(arguments.value(1));
+        QVariantMap partitionTableProperties = d_ptr->m_interfacePropertyMap.value(UDISKS2_PARTITION_TABLE_INTERFACE);
+        for (QMap<QString, QVariant>::const_iterator i = changedProperties.constBegin(); i != changedProperties.constEnd(); ++i) {
+            partitionTableProperties.insert(i.key(), i.value());
+        }
+        d_ptr->m_interfacePropertyMap.insert(UDISKS2_PARTITION_TABLE_INTERFACE, partitionTableProperties);
+
+        emit updated();
     }
 }
 
@@ -548,6 +567,11 @@ void UDisks2::Block::rescan(const QString &dbusObjectPath)
     });
 }
 
+int UDisks2::Block::propertyQueryCount()
+{
+    return propertyQueries;
+}
+
 void UDisks2::Block::getProperties(const QString &path, const QString &interface,
                                    bool *pending,
                                    std::function<void (const QVariantMap &)> success,
@@ -559,6 +583,7 @@ void UDisks2::Block::getProperties(const QString &path, const QString &interface
     }
 
     *pending = true;
+    ++propertyQueries;
 
     NemoDBus::Interface dbusPropertyInterface(this, d_ptr->m_connection,
                                               UDISKS2_SERVICE, path, DBUS_OBJECT_PROPERTIES_INTERFACE);
@@ -69,6 +69,8 @@ public:
     QString partitionTable() const;
     bool isPartition() const;
     bool isPartitionTable() const;
+    // Object paths of the partitions of a partition table
+    QStringList partitions() const;
 
     qint64 deviceNumber() const;
     QString id() const;
@@ -112,6 +114,9 @@ public:
 
     static QString cryptoBackingDevicePath(const QString &objectPath);
 
+    // The properties GetAll calls made by all the blocks, to log the round trips of populating
+    static int propertyQueryCount();
+
 signals:
     void completed(QPrivateSignal);
     void updated();
@@ -33,15 +33,41 @@
 #include "partitionmanager_p.h"
 #include "logging_p.h"
 
+#include <nemo-dbus/dbus.h>
+
+#include <QDBusMessage>
+#include <QDir>
+#include <QFile>
 #include <QRegularExpression>
+#include <QSet>
 #include <QTimerEvent>
 
 #include <QDebug>
 
+// Only a safety net, waits normally end as soon as the partitions are known
 #define PARTITION_WAIT_TIMEOUT 3000
 
 using namespace UDisks2;
 
+// The kernel creates the partition devices before announcing the disk, so sysfs
+// tells whether udisks still has partitions of the disk to announce.
+static bool hasKernelPartitions(const QString &devicePath)
+{
+    const QString name = devicePath.section(QLatin1Char('/'), -1);
+    if (name.isEmpty()) {
+        return false;
+    }
+
+    const QDir dir(QStringLiteral("/sys/class/block/") + name);
+    const QStringList entries = dir.entryList(QStringList() << name + QLatin1Char('*'), QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &entry : entries) {
+        if (QFile::exists(dir.filePath(entry + QStringLiteral("/partition")))) {
+            return true;
+        }
+    }
+    return false;
+}
+
 QPointer<BlockDevices> BlockDevices::sharedInstance = nullptr;
 
 BlockDevices *BlockDevices::instance()
@@ -56,6 +82,11 @@ BlockDevices::~BlockDevices()
 
     m_activeBlockDevices.clear();
     m_partitionWaits.clear();
+    m_indexedBlocks.clear();
+    m_deviceIndex.clear();
+    m_cryptoBackingDeviceIndex.clear();
+    m_cryptoBackingObjectIndex.clear();
+    m_partitionTableIndex.clear();
     sharedInstance = nullptr;
 }
 
@@ -68,9 +99,15 @@ void BlockDevices::remove(const QString &dbusObjectPath)
 {
     if (contains(dbusObjectPath)) {
         Block *block = m_blockDevices.take(dbusObjectPath);
-        m_activeBlockDevices.remove(dbusObjectPath);
+        Block *active = m_activeBlockDevices.take(dbusObjectPath);
+        if (active != block) {
+            updateIndex(active);
+        }
         clearPartitionWait(dbusObjectPath, false);
-        delete block;
+        if (block) {
+            updateIndex(block);
+            delete block;
+        }
     }
 }
 
@@ -85,12 +122,19 @@ Block *BlockDevices::device(const QString &dbusObjectPath) const
 
 void BlockDevices::deactivate(const QString &dbusObjectPath)
 {
-    m_activeBlockDevices.remove(dbusObjectPath);
+    if (Block *block = m_activeBlockDevices.take(dbusObjectPath)) {
+        updateIndex(block);
+    }
 }
 
 void BlockDevices::insert(const QString &dbusObjectPath, Block *block)
 {
+    Block *previous = m_activeBlockDevices.value(dbusObjectPath, nullptr);
     m_activeBlockDevices.insert(dbusObjectPath, block);
+    if (previous && previous != block) {
+        updateIndex(previous);
+    }
+    updateIndex(block);
 }
 
 Block *BlockDevices::find(std::function<bool (const Block *)> condition)
@@ -121,29 +165,15 @@ Block *BlockDevices::find(std::function<bool (const Block *)> condition)
 
 Block *BlockDevices::find(const QString &devicePath)
 {
-    return find([devicePath](const Block *block){
-        return block->device() == devicePath || block->cryptoBackingDevicePath() == devicePath;
-    });
+    return preferred(m_deviceIndex.values(devicePath) + m_cryptoBackingDeviceIndex.values(devicePath), true);
 }
 
 QString BlockDevices::objectPath(const QString &devicePath) const
 {
-    for (QMap<QString, Block *>::const_iterator i = m_activeBlockDevices.constBegin(); i != m_activeBlockDevices.constEnd(); ++i) {
-        Block *block = i.value();
-        if (block->device() == devicePath) {
-            return block->path();
-        } else if (block->cryptoBackingDevicePath() == devicePath) {
-            return block->cryptoBackingDeviceObjectPath();
-        }
-    }
-
-    for (QMap<QString, Block *>::const_iterator i = m_blockDevices.constBegin(); i != m_blockDevices.constEnd(); ++i) {
-        Block *block = i.value();
-        if (block->device() == devicePath) {
-            return block->path();
-        } else if (block->cryptoBackingDevicePath() == devicePath) {
-            return block->cryptoBackingDeviceObjectPath();
-        }
+    if (Block *block = preferred(m_deviceIndex.values(devicePath), false)) {
+        return block->path();
+    } else if (Block *block = preferred(m_cryptoBackingDeviceIndex.values(devicePath), false)) {
+        return block->cryptoBackingDeviceObjectPath();
     }
 
     return QString();
@@ -153,16 +183,18 @@ QStringList BlockDevices::devicePaths(const QStringList &dbusObjectPaths) const
 {
     QStringList paths;
     for (const QString &objectPath : dbusObjectPaths) {
-        for (QMap<QString, Block *>::const_iterator i = m_activeBlockDevices.constBegin(); i != m_activeBlockDevices.constEnd(); ++i) {
-            Block *block = i.value();
-            if (block->path() == objectPath || block->cryptoBackingDeviceObjectPath() == objectPath) {
-                paths << block->device();
-            }
+        QList<Block *> blocks = m_cryptoBackingObjectIndex.values(objectPath);
+        if (Block *block = m_activeBlockDevices.value(objectPath, nullptr)) {
+            blocks.append(block);
+        }
+        if (Block *block = m_blockDevices.value(objectPath, nullptr)) {
+            blocks.append(block);
         }
 
-        for (QMap<QString, Block *>::const_iterator i = m_blockDevices.constBegin(); i != m_blockDevices.constEnd(); ++i) {
-            Block *block = i.value();
-            if (block->path() == objectPath || block->cryptoBackingDeviceObjectPath() == objectPath) {
+        QSet<Block *> seen;
+        for (Block *block : blocks) {
+            if (rank(block) <= 1 && !seen.contains(block)) {
+                seen.insert(block);
                 paths << block->device();
             }
         }
@@ -172,16 +204,28 @@ QStringList BlockDevices::devicePaths(const QStringList &dbusObjectPaths) const
 
 bool BlockDevices::createBlockDevice(const QString &dbusObjectPath, const InterfacePropertyMap &interfacePropertyMap)
 {
+    if (m_rejectedBlocks.contains(dbusObjectPath)
+            || (!device(dbusObjectPath) && rejectEarly(dbusObjectPath, interfacePropertyMap))) {
+        return false;
+    }
     return doCreateBlockDevice(dbusObjectPath, interfacePropertyMap);
 }
 
-void BlockDevices::createBlockDevices(const QList<QDBusObjectPath> &devices)
+void BlockDevices::createBlockDevices(const QMap<QString, InterfacePropertyMap> &devices)
 {
-    m_blockCount = devices.count();
+    QMap<QString, InterfacePropertyMap> accepted;
+    for (QMap<QString, InterfacePropertyMap>::const_iterator i = devices.constBegin(); i != devices.constEnd(); ++i) {
+        if (!rejectEarly(i.key(), i.value())) {
+            accepted.insert(i.key(), i.value());
+        }
+    }
+    qCInfo(lcMemoryCardLog) << "Accepted" << accepted.count() << "of" << devices.count() << "block devices";
+
+    m_blockCount = accepted.count();
     updatePopulatedCheck();
 
-    for (const QDBusObjectPath &dbusObjectPath : devices) {
-        createBlockDevice(dbusObjectPath.path(), UDisks2::InterfacePropertyMap());
+    for (QMap<QString, InterfacePropertyMap>::const_iterator i = accepted.constBegin(); i != accepted.constEnd(); ++i) {
+        doCreateBlockDevice(i.key(), i.value());
     }
 }
 
@@ -197,6 +241,30 @@ void BlockDevices::lock(const QString &dbusObjectPath)
 void BlockDevices::waitPartition(Block *block)
 {
     m_partitionWaits.insert(block->path(), new PartitionWaiter(startTimer(PARTITION_WAIT_TIMEOUT), block));
+    checkPartitionWait(block->path());
+}
+
+// Ends the wait of a partition table once it is known whether it has partitions. Bare
+// blocks have nothing to tell and are left for the timeout.
+void BlockDevices::checkPartitionWait(const QString &dbusObjectPath)
+{
+    PartitionWaiter *waiter = m_partitionWaits.value(dbusObjectPath, nullptr);
+    if (!waiter || !waiter->block || !waiter->block->isPartitionTable()) {
+        return;
+    }
+
+    if (m_partitionTableIndex.contains(dbusObjectPath) || m_rejectedPartitions.contains(dbusObjectPath)) {
+        // Partitions have already completed or been rejected, the table itself is not exposed.
+        // Deleted later as this may run in a slot of the table block.
+        Block *partitionTable = waiter->block;
+        qCInfo(lcMemoryCardLog) << "Partitions of" << partitionTable->device() << "already known";
+        clearPartitionWait(dbusObjectPath, false);
+        partitionTable->deleteLater();
+    } else if (waiter->block->partitions().isEmpty() && !hasKernelPartitions(waiter->block->device())) {
+        qCInfo(lcMemoryCardLog) << "Partition table" << waiter->block->device() << "has no partitions";
+        complete(waiter->block, true);
+        clearPartitionWait(dbusObjectPath, false);
+    }
 }
 
 void BlockDevices::clearPartitionWait(const QString &dbusObjectPath, bool destroyBlock)
@@ -218,15 +286,29 @@ void BlockDevices::clearPartitionWait(const QString &dbusObjectPath, bool destro
 
 void BlockDevices::removeInterfaces(const QString &dbusObjectPath, const QStringList &interfaces)
 {
+    if (interfaces.contains(UDISKS2_BLOCK_INTERFACE)) {
+        m_rejectedBlocks.remove(dbusObjectPath);
+        m_rejectedPartitions.remove(dbusObjectPath);
+        for (auto it = m_rejectedPartitions.begin(); it != m_rejectedPartitions.end();) {
+            if (it.value() == dbusObjectPath) {
+                it = m_rejectedPartitions.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
     clearPartitionWait(dbusObjectPath, false);
 
     UDisks2::Block *block = device(dbusObjectPath);
     if (block) {
 
         if (interfaces.contains(UDISKS2_BLOCK_INTERFACE)) {
-            delete block;
             m_activeBlockDevices.remove(dbusObjectPath);
             m_blockDevices.remove(dbusObjectPath);
+            m_pendingBlockDevices.remove(dbusObjectPath);
+            updateIndex(block);
+            delete block;
         } else {
             if (interfaces.contains(UDISKS2_FILESYSTEM_INTERFACE)) {
                 block->removeInterface(UDISKS2_FILESYSTEM_INTERFACE);
@@ -238,6 +320,20 @@ void BlockDevices::removeInterfaces(const QString &dbusObjectPath, const QString
     }
 }
 
+void BlockDevices::propertiesChanged(const QDBusMessage &message)
+{
+    QList<QPointer<Block> > blocks;
+    for (Block *block : m_blocks.values(message.path())) {
+        blocks.append(block);
+    }
+
+    for (const QPointer<Block> &block : blocks) {
+        if (block) {
+            block->updateProperties(message);
+        }
+    }
+}
+
 bool BlockDevices::populated() const
 {
     return m_populated;
@@ -255,9 +351,18 @@ bool BlockDevices::hintAuto(const Block *maybeHintAuto)
 
 bool BlockDevices::hintAuto(const QString &devicePath)
 {
-    Block *maybeHintAuto = find([devicePath](const Block *block) {
-        return block->device() == devicePath || block->path() == devicePath;
-    });
+    QList<Block *> candidates = m_deviceIndex.values(devicePath);
+    if (Block *block = m_activeBlockDevices.value(devicePath, nullptr)) {
+        candidates.append(block);
+    }
+    if (Block *block = m_blockDevices.value(devicePath, nullptr)) {
+        candidates.append(block);
+    }
+    if (Block *block = m_pendingBlockDevices.value(devicePath, nullptr)) {
+        candidates.append(block);
+    }
+
+    Block *maybeHintAuto = preferred(candidates, true);
     if (!maybeHintAuto)
         return false;
 
@@ -285,12 +390,72 @@ void BlockDevices::blockCompleted()
 
 BlockDevices::BlockDevices(QObject *parent)
     : QObject(parent)
+    , m_rejectedCount(0)
     , m_blockCount(0)
     , m_populated(false)
 {
     Q_ASSERT(!sharedInstance);
 
     sharedInstance = this;
+    m_populateTimer.start();
+}
+
+// Rejects blocks that complete() would throw away anyway, using only the properties
+// at hand, so that nothing is fetched over D-Bus for loop, zram, system partitions etc.
+bool BlockDevices::rejectEarly(const QString &dbusObjectPath, const InterfacePropertyMap &interfacePropertyMap)
+{
+    if (!interfacePropertyMap.contains(UDISKS2_BLOCK_INTERFACE)) {
+        return false;
+    }
+
+    const QVariantMap blockProperties = interfacePropertyMap.value(UDISKS2_BLOCK_INTERFACE);
+
+    // Unlocked crypto devices are judged by their backing device once complete.
+    const QString cryptoBackingDevice = NemoDBus::demarshallDBusArgument(
+                blockProperties.value(UDisks2::cryptoBackingDeviceKey)).toString();
+    if (!cryptoBackingDevice.isEmpty() && cryptoBackingDevice != QLatin1String("/")) {
+        return false;
+    }
+
+    static const QStringList virtualDevices = {
+        QStringLiteral("/dev/loop"),
+        QStringLiteral("/dev/zram"),
+        QStringLiteral("/dev/ram"),
+        QStringLiteral("/dev/mtdblock"),
+        QStringLiteral("/dev/dm")
+    };
+
+    const QString device = QString::fromLocal8Bit(blockProperties.value(QStringLiteral("Device")).toByteArray());
+
+    const char *reason = nullptr;
+    for (const QString &prefix : virtualDevices) {
+        if (device.startsWith(prefix)) {
+            reason = "virtual device";
+            break;
+        }
+    }
+
+    if (!reason && !blockProperties.value(QStringLiteral("HintAuto")).toBool()) {
+        reason = "no auto hint";
+    }
+
+    if (!reason) {
+        return false;
+    }
+
+    m_rejectedBlocks.insert(dbusObjectPath);
+    ++m_rejectedCount;
+    qCInfo(lcMemoryCardLog) << "Rejected block" << dbusObjectPath << device << "-" << reason
+                            << "- rejected blocks:" << m_rejectedCount;
+
+    // A rejected partition still means that its table is not exposed, as when a partition completes
+    const QString partitionTable = NemoDBus::demarshallDBusArgument(
+                interfacePropertyMap.value(UDISKS2_PARTITION_INTERFACE).value(QStringLiteral("Table"))).toString();
+    if (!partitionTable.isEmpty() && partitionTable != QLatin1String("/")) {
+        m_rejectedPartitions.insert(partitionTable, dbusObjectPath);
+        clearPartitionWait(partitionTable, true);
+    }
+    return true;
 }
 
 Block *BlockDevices::doCreateBlockDevice(const QString &dbusObjectPath, const InterfacePropertyMap &interfacePropertyMap)
@@ -319,6 +484,20 @@ Block *BlockDevices::doCreateBlockDevice(const QString &dbusObjectPath, const In
     Block *block = new Block(dbusObjectPath, interfacePropertyMap);
     updateFormattingState(block);
     connect(block, &Block::completed, this, &BlockDevices::blockCompleted);
+    connect(block, &Block::updated, this, [this, block]() {
+        updateIndex(block);
+
+        PartitionWaiter *waiter = m_partitionWaits.value(block->path(), nullptr);
+        if (waiter && waiter->block == block) {
+            checkPartitionWait(block->path());
+        }
+    });
+    m_blocks.insert(dbusObjectPath, block);
+    // A block may be destroyed behind our back, e.g. by a partition waiter.
+    connect(block, &QObject::destroyed, this, [this, block, dbusObjectPath]() {
+        m_blocks.remove(dbusObjectPath, block);
+        unindex(block);
+    });
     return block;
 }
 
@@ -363,6 +542,7 @@ void BlockDevices::complete(Block *block, bool forceAccept)
     // Mark a block as pending if block devices is not yet populated.
     if (!populated()) {
         m_pendingBlockDevices.insert(block->path(), block);
+        updateIndex(block);
         return;
     }
 
@@ -374,10 +554,14 @@ void BlockDevices::complete(Block *block, bool forceAccept)
     // Check if device is already unlocked.
     Block *unlocked = nullptr;
     if (block->isEncrypted()) {
-        QString newPath = block->path();
-        unlocked = find([newPath](const Block *block) {
-            return block->cryptoBackingDeviceObjectPath() == newPath && !block->isLocking();
-        });
+        const QList<Block *> candidates = m_cryptoBackingObjectIndex.values(block->path());
+        QList<Block *> unlockedCandidates;
+        for (Block *candidate : candidates) {
+            if (!candidate->isLocking()) {
+                unlockedCandidates.append(candidate);
+            }
+        }
+        unlocked = preferred(unlockedCandidates, true);
     }
 
     bool willAccept = !unlocked && (block->isPartition()
@@ -393,6 +577,7 @@ void BlockDevices::complete(Block *block, bool forceAccept)
         // Hope that somebody will handle this signal and call insert()
         // to add this block to m_activeBlockDevices.
         m_blockDevices.insert(block->path(), block);
+        updateIndex(block);
         emit newBlock(block, false);
     } else if (block->isPartition()) {
         // Silently keep partitions around so that we can filter out
@@ -416,15 +601,13 @@ void BlockDevices::timerEvent(QTimerEvent *e)
             qCDebug(lcMemoryCardLog) << "Waiting partitions:" << m_partitionWaits.keys() << path;
             dumpBlocks();
 
-            Block *partitionTable = find([path](const Block *block) {
-                return block->partitionTable() == path;
-            });
+            bool hasPartitions = m_partitionTableIndex.contains(path) || m_rejectedPartitions.contains(path);
 
             // No partition found that would be part of this partion table. Accept this one.
-            if (!partitionTable) {
+            if (!hasPartitions) {
                 complete(waiter->block, true);
             }
-            clearPartitionWait(path, partitionTable);
+            clearPartitionWait(path, hasPartitions);
             break;
         }
     }
@@ -436,17 +619,101 @@ void BlockDevices::updatePopulatedCheck()
         --m_blockCount;
         if (m_blockCount <= 0) {
             m_populated = true;
+            qCInfo(lcMemoryCardLog, "Block devices populated: blocks=%d property_queries=%d populated_ms=%lld",
+                   m_blockDevices.count(), Block::propertyQueryCount(), m_populateTimer.elapsed());
 
-            for (Block *block : m_pendingBlockDevices) {
+            const QList<Block *> pending = m_pendingBlockDevices.values();
+            for (Block *block : pending) {
                 complete(block);
             }
             m_pendingBlockDevices.clear();
+            // Drops the rejected blocks from the indexes.
+            for (Block *block : pending) {
+                updateIndex(block);
+            }
             emit externalStoragesPopulated();
             m_blockCount = 0;
         }
     }
 }
 
+bool BlockDevices::isTracked(const Block *block) const
+{
+    const QString path = block->path();
+    return m_activeBlockDevices.value(path, nullptr) == block
+            || m_blockDevices.value(path, nullptr) == block
+            || m_pendingBlockDevices.value(path, nullptr) == block;
+}
+
+// Lookups prefer active blocks over the existing and then the pending ones, like the scans did.
+int BlockDevices::rank(const Block *block) const
+{
+    const QString path = block->path();
+    if (m_activeBlockDevices.value(path, nullptr) == block) {
+        return 0;
+    } else if (m_blockDevices.value(path, nullptr) == block) {
+        return 1;
+    }
+    return 2;
+}
+
+Block *BlockDevices::preferred(const QList<Block *> &candidates, bool includePending) const
+{
+    Block *best = nullptr;
+    int bestRank = includePending ? 3 : 2;
+    for (Block *block : candidates) {
+        const int blockRank = rank(block);
+        if (blockRank < bestRank) {
+            best = block;
+            bestRank = blockRank;
+        }
+    }
+    return best;
+}
+
+void BlockDevices::updateIndex(Block *block)
+{
+    unindex(block);
+
+    if (!isTracked(block)) {
+        return;
+    }
+
+    IndexKeys keys;
+    keys.device = block->device();
+    keys.cryptoBackingDeviceObjectPath = block->hasCryptoBackingDevice()
+            ? block->cryptoBackingDeviceObjectPath() : QString();
+    keys.cryptoBackingDevicePath = Block::cryptoBackingDevicePath(keys.cryptoBackingDeviceObjectPath);
+    keys.partitionTable = block->partitionTable();
+
+    if (!keys.device.isEmpty())
+        m_deviceIndex.insert(keys.device, block);
+    if (!keys.cryptoBackingDevicePath.isEmpty())
+        m_cryptoBackingDeviceIndex.insert(keys.cryptoBackingDevicePath, block);
+    if (!keys.cryptoBackingDeviceObjectPath.isEmpty())
+        m_cryptoBackingObjectIndex.insert(keys.cryptoBackingDeviceObjectPath, block);
+    if (!keys.partitionTable.isEmpty() && keys.partitionTable != QLatin1String("/"))
+        m_partitionTableIndex.insert(keys.partitionTable, block);
+
+    m_indexedBlocks.insert(block, keys);
+}
+
+// Does not dereference the block, which may already be destroyed.
+void BlockDevices::unindex(Block *block)
+{
+    QHash<Block *, IndexKeys>::iterator it = m_indexedBlocks.find(block);
+    if (it == m_indexedBlocks.end()) {
+        return;
+    }
+
+    const IndexKeys &keys = it.value();
+    m_deviceIndex.remove(keys.device, block);
+    m_cryptoBackingDeviceIndex.remove(keys.cryptoBackingDevicePath, block);
+    m_cryptoBackingObjectIndex.remove(keys.cryptoBackingDeviceObjectPath, block);
+    m_partitionTableIndex.remove(keys.partitionTable, block);
+    m_indexedBlocks.erase(it);
+}
+
 BlockDevices::PartitionWaiter::PartitionWaiter(int timer, Block *block)
     : timer(timer)
     , block(block)
@@ -32,13 +32,17 @@
 #ifndef UDISKS2_BLOCK_DEVICES_H
 #define UDISKS2_BLOCK_DEVICES_H
 
+#include <QElapsedTimer>
+#include <QHash>
 #include <QMap>
 #include <QPointer>
+#include <QSet>
 #include <functional>
 #include <QDBusObjectPath>
 
 #include "udisks2block_p.h"
 
+class QDBusMessage;
 class QTimerEvent;
 
 namespace UDisks2 {
@@ -64,14 +68,17 @@ public:
     QStringList devicePaths(const QStringList &dbusObjectPaths) const;
 
     bool createBlockDevice(const QString &dbusObjectPath, const InterfacePropertyMap &interfacePropertyMap);
-    void createBlockDevices(const QList<QDBusObjectPath> &devices);
+    void createBlockDevices(const QMap<QString, InterfacePropertyMap> &devices);
     void lock(const QString &dbusObjectPath);
 
     void waitPartition(Block *block);
+    void checkPartitionWait(const QString &dbusObjectPath);
     void clearPartitionWait(const QString &dbusObjectPath, bool destroyBlock);
 
     void removeInterfaces(const QString &dbusObjectPath, const QStringList &interfaces);
 
+    void propertiesChanged(const QDBusMessage &message);
+
     bool hintAuto(const QString &dbusObjectPath);
     bool hintAuto(const Block *maybeHintAuto);
 
@@ -95,7 +102,17 @@ private:
         Block *block;
     };
 
+    // Keys a block is currently indexed with, so that they can be removed even
+    // after the block has changed or is being destroyed.
+    struct IndexKeys {
+        QString device;
+        QString cryptoBackingDevicePath;
+        QString cryptoBackingDeviceObjectPath;
+        QString partitionTable;
+    };
+
     BlockDevices(QObject *parent = nullptr);
+    bool rejectEarly(const QString &dbusObjectPath, const InterfacePropertyMap &interfacePropertyMap);
     Block *doCreateBlockDevice(const QString &dbusObjectPath, const InterfacePropertyMap &interfacePropertyMap);
     void updateFormattingState(Block *block);
 
@@ -104,13 +121,36 @@ private:
     void timerEvent(QTimerEvent *e) override;
     void updatePopulatedCheck();
 
+    bool isTracked(const Block *block) const;
+    int rank(const Block *block) const;
+    Block *preferred(const QList<Block *> &candidates, bool includePending) const;
+    void updateIndex(Block *block);
+    void unindex(Block *block);
+
     QMap<QString, Block *> m_activeBlockDevices;
     QMap<QString, Block *> m_blockDevices;
     QMap<QString, Block *> m_pendingBlockDevices;
 
+    // All the blocks created, including the ones not yet completed, for delivering property changes
+    QMultiHash<QString, Block *> m_blocks;
+
+    // Indexes over the blocks of the three maps above
+    QHash<Block *, IndexKeys> m_indexedBlocks;
+    QMultiHash<QString, Block *> m_deviceIndex;
+    QMultiHash<QString, Block *> m_cryptoBackingDeviceIndex;
+    QMultiHash<QString, Block *> m_cryptoBackingObjectIndex;
+    QMultiHash<QString, Block *> m_partitionTableIndex;
+
     QMap<QString, PartitionWaiter*> m_partitionWaits;
+    // Blocks rejected from their InterfacesAdded payload, for which no Block is created
+    QSet<QString> m_rejectedBlocks;
+    // Rejected partitions by the object path of their partition table
+    QMultiHash<QString, QString> m_rejectedPartitions;
+    int m_rejectedCount;
     int m_blockCount;
     bool m_populated;
+    // From the creation of the instance at startup until the block devices are populated
+    QElapsedTimer m_populateTimer;
 
     static QPointer<BlockDevices> sharedInstance;
 };
@@ -32,6 +32,7 @@
 #ifndef UDISKS2_DEFINES
 #define UDISKS2_DEFINES
 
+#include <QDBusObjectPath>
 #include <QVariantMap>
 
 namespace UDisks2 {
@@ -41,17 +42,22 @@ namespace UDisks2 {
     static const auto cryptoBackingDeviceKey  = QStringLiteral("CryptoBackingDevice");
 
     typedef QMap<QString, QVariantMap> InterfacePropertyMap;
+    typedef QMap<QDBusObjectPath, InterfacePropertyMap> ObjectInterfacePropertyMap;
 }
 
 Q_DECLARE_METATYPE(UDisks2::InterfacePropertyMap)
+Q_DECLARE_METATYPE(UDisks2::ObjectInterfacePropertyMap)
 
 #define DBUS_OBJECT_MANAGER_INTERFACE    QLatin1String("org.freedesktop.DBus.ObjectManager")
 #define DBUS_OBJECT_PROPERTIES_INTERFACE QLatin1String("org.freedesktop.DBus.Properties")
 #define DBUS_GET_ALL                     QLatin1String("GetAll")
+#define DBUS_GET_MANAGED_OBJECTS         QLatin1String("GetManagedObjects")
 
 #define UDISKS2_SERVICE         QLatin1String("org.freedesktop.UDisks2")
 #define UDISKS2_PATH            QLatin1String("/org/freedesktop/UDisks2")
 #define UDISKS2_MANAGER_PATH    QLatin1String("/org/freedesktop/UDisks2/Manager")
+#define UDISKS2_BLOCK_DEVICES_PATH_PREFIX QLatin1String("/org/freedesktop/UDisks2/block_devices/")
+#define UDISKS2_DRIVES_PATH_PREFIX        QLatin1String("/org/freedesktop/UDisks2/drives/")
 
 // Interfaces
 #define UDISKS2_MANAGER_INTERFACE          QLatin1String("org.freedesktop.UDisks2.Manager")
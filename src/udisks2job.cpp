@@ -30,7 +30,6 @@
  */
 
 #include "udisks2job_p.h"
-#include "udisks2monitor_p.h"
 #include "udisks2defines.h"
 #include "logging_p.h"
 
@@ -46,19 +45,6 @@ UDisks2::Job::Job(const QString &path, const QVariantMap &data, QObject *parent)
     , m_completed(false)
     , m_success(false)
 {
-    // might be error-prone if there are multiple simultaneous jobs on an object.
-    // is this even needed?
-    connect(Monitor::instance(), &Monitor::errorMessage,
-            this, [this](const QString &objectPath, const QString &errorName) {
-        if (objects().contains(objectPath) && errorName == UDISKS2_ERROR_DEVICE_BUSY) {
-            if (!isCompleted()) {
-                m_message = errorName;
-                if (deviceBusy()) {
-                    complete(false, m_message);
-                }
-            }
-        }
-    });
 }
 
 UDisks2::Job::~Job()
@@ -98,6 +84,20 @@ bool UDisks2::Job::deviceBusy() const
     return m_message == UDISKS2_ERROR_TARGET_BUSY || m_message == UDISKS2_ERROR_DEVICE_BUSY;
 }
 
+// might be error-prone if there are multiple simultaneous jobs on an object.
+// is this even needed?
+void UDisks2::Job::handleError(const QString &objectPath, const QString &errorName)
+{
+    if (objects().contains(objectPath) && errorName == UDISKS2_ERROR_DEVICE_BUSY) {
+        if (!isCompleted()) {
+            m_message = errorName;
+            if (deviceBusy()) {
+                complete(false, m_message);
+            }
+        }
+    }
+}
+
 QStringList UDisks2::Job::objects() const
 {
     return value(UDISKS2_JOB_KEY_OBJECTS).toStringList();
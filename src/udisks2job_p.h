@@ -68,6 +68,9 @@ public:
     QString message() const;
     bool deviceBusy() const;
 
+    // Called by the monitor for failed calls on any object
+    void handleError(const QString &objectPath, const QString &errorName);
+
     QStringList objects() const;
 
     QString path() const;
@@ -42,8 +42,9 @@
 #include <QDBusConnection>
 #include <QDBusConnectionInterface>
 #include <QDBusError>
-#include <QDBusInterface>
+#include <QDBusMessage>
 #include <QDBusMetaType>
+#include <QElapsedTimer>
 
 struct ErrorEntry {
     Partition::Error errorCode;
@@ -70,6 +71,24 @@ static const ErrorEntry dbus_error_entries[] =
     { Partition::ErrorDeviceBusy,             "org.freedesktop.UDisks2.Error.DeviceBusy" }
 };
 
+// Calls are built directly instead of through QDBusInterface, which would introspect
+// the object synchronously before sending anything.
+static QDBusPendingCall asyncCall(const QString &path, const QString &interface, const QString &method,
+                                  const QVariantList &arguments = QVariantList())
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QDBusMessage call = QDBusMessage::createMethodCall(UDISKS2_SERVICE, path, interface, method);
+    call.setArguments(arguments);
+    const QDBusPendingCall pendingCall = QDBusConnection::systemBus().asyncCall(call);
+
+    // The time the caller is blocked issuing the call, without any round trip to udisks
+    qCDebug(lcMemoryCardLog, "Issued %s.%s path=%s issue_us=%lld", qPrintable(interface), qPrintable(method),
+            qPrintable(path), timer.nsecsElapsed() / 1000);
+    return pendingCall;
+}
+
 UDisks2::Monitor *UDisks2::Monitor::sharedInstance = nullptr;
 
 UDisks2::Monitor *UDisks2::Monitor::instance()
@@ -88,6 +107,7 @@ UDisks2::Monitor::Monitor(PartitionManagerPrivate *manager, QObject *parent)
     sharedInstance = this;
 
     qDBusRegisterMetaType<UDisks2::InterfacePropertyMap>();
+    qDBusRegisterMetaType<UDisks2::ObjectInterfacePropertyMap>();
     QDBusConnection systemBus = QDBusConnection::systemBus();
 
     connect(systemBus.interface(), &QDBusConnectionInterface::callWithCallbackFailed,
@@ -100,6 +120,10 @@ UDisks2::Monitor::Monitor(PartitionManagerPrivate *manager, QObject *parent)
         qCInfo(lcMemoryCardLog) << "Call interface:" << call.interface();
         qCInfo(lcMemoryCardLog) << "Call path:" << call.path();
         qCInfo(lcMemoryCardLog) << "====================================================";
+        const QList<UDisks2::Job *> jobs = m_jobsToWait.values();
+        for (UDisks2::Job *job : jobs) {
+            job->handleError(call.path(), error.name());
+        }
         emit errorMessage(call.path(), error.name());
     });
 
@@ -123,6 +147,18 @@ UDisks2::Monitor::Monitor(PartitionManagerPrivate *manager, QObject *parent)
         qCWarning(lcMemoryCardLog) << "Failed to connect to interfaces removed signal:" << qPrintable(systemBus.lastError().message());
     }
 
+    // One match rule for the property changes of all the udisks objects, which are
+    // handed to the blocks by object path.
+    if (!systemBus.connect(
+                UDISKS2_SERVICE,
+                QString(),
+                DBUS_OBJECT_PROPERTIES_INTERFACE,
+                propertiesChangedSignal,
+                this,
+                SLOT(propertiesChanged(QDBusMessage)))) {
+        qCWarning(lcMemoryCardLog) << "Failed to connect to properties changed signal:" << qPrintable(systemBus.lastError().message());
+    }
+
     if (!QDBusConnection::systemBus().connect(
                 UDISKS2_SERVICE,
                 QString(),
@@ -259,8 +295,14 @@ void UDisks2::Monitor::interfacesAdded(const QDBusObjectPath &objectPath, const
     qCInfo(lcMemoryCardLog) << "UDisks dump interface:" << interfaces;
     // A device must have file system or partition so that it can added to the model.
     // Devices without partition table can have a filesystem interface.
-    if (path.startsWith(QStringLiteral("/org/freedesktop/UDisks2/block_devices/"))) {
-        m_blockDevices->createBlockDevice(path, interfaces);
+    if (path.startsWith(UDISKS2_BLOCK_DEVICES_PATH_PREFIX)) {
+        UDisks2::InterfacePropertyMap blockInterfaces = interfaces;
+        addDriveProperties(&blockInterfaces);
+        m_blockDevices->createBlockDevice(path, blockInterfaces);
+    } else if (path.startsWith(UDISKS2_DRIVES_PATH_PREFIX)) {
+        if (interfaces.contains(UDISKS2_DRIVE_INTERFACE)) {
+            m_drives.insert(path, interfaces.value(UDISKS2_DRIVE_INTERFACE));
+        }
     } else if (path.startsWith(QStringLiteral("/org/freedesktop/UDisks2/jobs"))) {
         QVariantMap dict = interfaces.value(UDISKS2_JOB_INTERFACE);
         QString operation = dict.value(UDISKS2_JOB_KEY_OPERATION, QString()).toString();
@@ -308,7 +350,11 @@ void UDisks2::Monitor::interfacesRemoved(const QDBusObjectPath &objectPath, cons
     qCDebug(lcMemoryCardLog) << "UDisks interface removed:" << path;
     qCInfo(lcMemoryCardLog) << "UDisks dump interface:" << interfaces;
 
-    if (m_jobsToWait.contains(path)) {
+    if (path.startsWith(UDISKS2_DRIVES_PATH_PREFIX)) {
+        if (interfaces.contains(UDISKS2_DRIVE_INTERFACE)) {
+            m_drives.remove(path);
+        }
+    } else if (m_jobsToWait.contains(path)) {
         UDisks2::Job *job = m_jobsToWait.take(path);
         // Make sure job is completed. Not sure if we can assume it success really.
         if (!job->isCompleted()) {
@@ -328,6 +374,23 @@ void UDisks2::Monitor::interfacesRemoved(const QDBusObjectPath &objectPath, cons
     }
 }
 
+void UDisks2::Monitor::propertiesChanged(const QDBusMessage &message)
+{
+    const QString path = message.path();
+    if (path.startsWith(UDISKS2_BLOCK_DEVICES_PATH_PREFIX)) {
+        m_blockDevices->propertiesChanged(message);
+    } else if (path.startsWith(UDISKS2_DRIVES_PATH_PREFIX)) {
+        const QList<QVariant> arguments = message.arguments();
+        QHash<QString, QVariantMap>::iterator it = m_drives.find(path);
+        if (it != m_drives.end() && arguments.value(0).toString() == UDISKS2_DRIVE_INTERFACE) {
+            const QVariantMap changedProperties = NemoDBus::demarshallArgument<QVariantMap>(arguments.value(1));
+            for (QVariantMap::const_iterator i = changedProperties.constBegin(); i != changedProperties.constEnd(); ++i) {
+                it.value().insert(i.key(), i.value());
+            }
+        }
+    }
+}
+
 void UDisks2::Monitor::setPartitionProperties(QExplicitlySharedDataPointer<PartitionPrivate> &partition,
                                               const UDisks2::Block *blockDevice)
 {
@@ -347,9 +410,9 @@ void UDisks2::Monitor::setPartitionProperties(QExplicitlySharedDataPointer<Parti
     partition->mountPath = blockDevice->mountPath();
     partition->deviceLabel = label;
     partition->filesystemType = blockDevice->idType();
-    partition->isSupportedFileSystemType = m_manager->supportedFileSystems().contains(partition->filesystemType);
+    partition->isSupportedFileSystemType = m_manager->isSupportedFileSystem(partition->filesystemType);
     partition->readOnly = blockDevice->isReadOnly();
-    partition->canMount = blockDevice->isMountable() && m_manager->supportedFileSystems().contains(partition->filesystemType);
+    partition->canMount = blockDevice->isMountable() && partition->isSupportedFileSystemType;
 
     if (blockDevice->isFormatting()) {
         partition->status = Partition::Formatting;
@@ -486,12 +549,7 @@ void UDisks2::Monitor::startLuksOperation(const QString &devicePath, const QStri
         return;
     }
 
-    QDBusInterface udisks2Interface(UDISKS2_SERVICE,
-                                    dbusObjectPath,
-                                    UDISKS2_ENCRYPTED_INTERFACE,
-                                    QDBusConnection::systemBus());
-
-    QDBusPendingCall pendingCall = udisks2Interface.asyncCallWithArgumentList(dbusMethod, arguments);
+    QDBusPendingCall pendingCall = asyncCall(dbusObjectPath, UDISKS2_ENCRYPTED_INTERFACE, dbusMethod, arguments);
     QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pendingCall, this);
     connect(watcher, &QDBusPendingCallWatcher::finished,
             this, [this, devicePath, dbusMethod](QDBusPendingCallWatcher *watcher) {
@@ -549,12 +607,7 @@ void UDisks2::Monitor::startMountOperation(const QString &devicePath, const QStr
         return;
     }
 
-    QDBusInterface udisks2Interface(UDISKS2_SERVICE,
-                                    dbusObjectPath,
-                                    UDISKS2_FILESYSTEM_INTERFACE,
-                                    QDBusConnection::systemBus());
-
-    QDBusPendingCall pendingCall = udisks2Interface.asyncCallWithArgumentList(dbusMethod, arguments);
+    QDBusPendingCall pendingCall = asyncCall(dbusObjectPath, UDISKS2_FILESYSTEM_INTERFACE, dbusMethod, arguments);
     QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pendingCall, this);
     connect(watcher, &QDBusPendingCallWatcher::finished,
             this, [this, devicePath, dbusMethod](QDBusPendingCallWatcher *watcher) {
@@ -642,12 +695,8 @@ void UDisks2::Monitor::createPartition(const UDisks2::Block *block)
 void UDisks2::Monitor::doFormat(const QString &devicePath, const QString &dbusObjectPath,
                                 const QString &filesystemType, const QVariantMap &arguments)
 {
-    QDBusInterface blockDeviceInterface(UDISKS2_SERVICE,
-                                    dbusObjectPath,
-                                    UDISKS2_BLOCK_INTERFACE,
-                                    QDBusConnection::systemBus());
-
-    QDBusPendingCall pendingCall = blockDeviceInterface.asyncCall(UDISKS2_BLOCK_FORMAT, filesystemType, arguments);
+    QDBusPendingCall pendingCall = asyncCall(dbusObjectPath, UDISKS2_BLOCK_INTERFACE, UDISKS2_BLOCK_FORMAT,
+                                             QVariantList() << filesystemType << arguments);
     QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pendingCall, this);
     connect(watcher, &QDBusPendingCallWatcher::finished,
             this, [this, devicePath, dbusObjectPath, arguments](QDBusPendingCallWatcher *watcher) {
@@ -674,28 +723,77 @@ void UDisks2::Monitor::doFormat(const QString &devicePath, const QString &dbusOb
     });
 }
 
+// All the block devices and drives are read from a single GetManagedObjects reply
+// instead of querying the properties of each interface of each block separately.
 void UDisks2::Monitor::getBlockDevices()
 {
-    QDBusInterface managerInterface(UDISKS2_SERVICE,
-                                    UDISKS2_MANAGER_PATH,
-                                    UDISKS2_MANAGER_INTERFACE,
-                                    QDBusConnection::systemBus());
-    QDBusPendingCall pendingCall = managerInterface.asyncCallWithArgumentList(
-                QStringLiteral("GetBlockDevices"),
-                QVariantList() << QVariantMap());
+    QDBusPendingCall pendingCall = asyncCall(UDISKS2_PATH, DBUS_OBJECT_MANAGER_INTERFACE, DBUS_GET_MANAGED_OBJECTS);
     QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pendingCall, this);
-    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *watcher) {
-        if (watcher->isValid() && watcher->isFinished()) {
-            QDBusPendingReply<QList<QDBusObjectPath> > reply = *watcher;
-            const QList<QDBusObjectPath> blockDevicePaths = reply.argumentAt<0>();
-            m_blockDevices->createBlockDevices(blockDevicePaths);
-        } else if (watcher->isError()) {
-            QDBusError error = watcher->error();
+    QElapsedTimer timer;
+    timer.start();
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, timer](QDBusPendingCallWatcher *watcher) {
+        QDBusPendingReply<UDisks2::ObjectInterfacePropertyMap> reply = *watcher;
+        if (reply.isValid()) {
+            const UDisks2::ObjectInterfacePropertyMap objects = reply.value();
+
+            for (UDisks2::ObjectInterfacePropertyMap::const_iterator i = objects.constBegin(); i != objects.constEnd(); ++i) {
+                const QString path = i.key().path();
+                if (path.startsWith(UDISKS2_DRIVES_PATH_PREFIX) && i.value().contains(UDISKS2_DRIVE_INTERFACE)) {
+                    m_drives.insert(path, i.value().value(UDISKS2_DRIVE_INTERFACE));
+                }
+            }
+
+            // Pass on only the interfaces that a block would otherwise query itself.
+            static const QStringList blockInterfaces = {
+                UDISKS2_BLOCK_INTERFACE,
+                UDISKS2_ENCRYPTED_INTERFACE,
+                UDISKS2_FILESYSTEM_INTERFACE,
+                UDISKS2_PARTITION_INTERFACE,
+                UDISKS2_PARTITION_TABLE_INTERFACE
+            };
+
+            QMap<QString, UDisks2::InterfacePropertyMap> blockDevices;
+            for (UDisks2::ObjectInterfacePropertyMap::const_iterator i = objects.constBegin(); i != objects.constEnd(); ++i) {
+                const QString path = i.key().path();
+                if (!path.startsWith(UDISKS2_BLOCK_DEVICES_PATH_PREFIX) || !i.value().contains(UDISKS2_BLOCK_INTERFACE)) {
+                    continue;
+                }
+
+                UDisks2::InterfacePropertyMap interfaces;
+                for (const QString &interface : blockInterfaces) {
+                    if (i.value().contains(interface)) {
+                        interfaces.insert(interface, i.value().value(interface));
+                    }
+                }
+                addDriveProperties(&interfaces);
+                blockDevices.insert(path, interfaces);
+            }
+
+            qCInfo(lcMemoryCardLog) << "Enumerated" << blockDevices.count() << "block devices and" << m_drives.count()
+                                    << "drives in" << timer.elapsed() << "ms";
+            m_blockDevices->createBlockDevices(blockDevices);
+        } else {
+            QDBusError error = reply.error();
             qCWarning(lcMemoryCardLog) << "Unable to enumerate block devices:" << error.name() << error.message();
         }
+        watcher->deleteLater();
     });
 }
 
+void UDisks2::Monitor::addDriveProperties(UDisks2::InterfacePropertyMap *interfaces) const
+{
+    if (!interfaces->contains(UDISKS2_BLOCK_INTERFACE)) {
+        return;
+    }
+
+    const QString drive = NemoDBus::demarshallDBusArgument(
+                interfaces->value(UDISKS2_BLOCK_INTERFACE).value(QStringLiteral("Drive"))).toString();
+    QHash<QString, QVariantMap>::const_iterator it = m_drives.constFind(drive);
+    if (it != m_drives.constEnd()) {
+        interfaces->insert(UDISKS2_DRIVE_INTERFACE, it.value());
+    }
+}
+
 void UDisks2::Monitor::connectSignals(UDisks2::Block *block)
 {
     connect(block, &UDisks2::Block::formatted, this, [this]() {
@@ -35,7 +35,9 @@
 #include <QObject>
 #include <QDBusObjectPath>
 #include <QDBusContext>
+#include <QDBusMessage>
 #include <QExplicitlySharedDataPointer>
+#include <QHash>
 #include <QRegularExpression>
 #include <QQueue>
 #include <QVariantList>
@@ -105,6 +107,7 @@ private slots:
                   const QVariantMap &arguments);
     void handleNewBlock(UDisks2::Block *block, bool forceCreatePartition);
     void jobCompleted(bool success, const QString &msg);
+    void propertiesChanged(const QDBusMessage &message);
 
 private:
     void setPartitionProperties(QExplicitlySharedDataPointer<PartitionPrivate> &partition, const Block *blockDevice);
@@ -119,6 +122,7 @@ private:
 
     void createPartition(const Block *block);
     void getBlockDevices();
+    void addDriveProperties(InterfacePropertyMap *interfaces) const;
     void connectSignals(UDisks2::Block *block);
 
 private:
@@ -130,6 +134,9 @@ private:
     QQueue<Operation> m_operationQueue;
 
     BlockDevices *m_blockDevices;
+
+    // Drive properties by drive object path, shared by the blocks of each drive
+    QHash<QString, QVariantMap> m_drives;
 };
 
 }
@@ -0,0 +1,1201 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "certificatemodel.h"
+
+#include <QDir>
+#include <QFile>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QThreadPool>
+#include <QtTest>
+
+#include <algorithm>
+#include <random>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+
+// Benchmarks of reading certificate bundles, on synthetic bundles of RSA and EC certificates
+// with UTCTime and GeneralizedTime validity, and tests of the models on a small fixture bundle
+// of a certificate chain. To compare the results of the benchmarks between releases, write
+// them in a machine readable format:
+//   tst_certificatemodel -o results.csv,csv
+//   tst_certificatemodel -o results.xml,xml
+
+namespace {
+
+const int BundleSizes[] = { 150, 1000, 10000 };
+const int LargestBundle = 10000;
+// The system has a bundle each for TLS, email and object signing, mostly of the same roots
+const int BundleCopies = 3;
+// The rows a model fetches at a time
+const int PageSize = 256;
+
+EVP_PKEY *generateKey(int type)
+{
+    EVP_PKEY *key = nullptr;
+    EVP_PKEY_CTX *context = EVP_PKEY_CTX_new_id(type, nullptr);
+    if (context && EVP_PKEY_keygen_init(context) > 0) {
+        const int configured = (type == EVP_PKEY_RSA)
+                ? EVP_PKEY_CTX_set_rsa_keygen_bits(context, 2048)
+                : EVP_PKEY_CTX_set_ec_paramgen_curve_nid(context, NID_X9_62_prime256v1);
+        if (configured > 0) {
+            EVP_PKEY_keygen(context, &key);
+        }
+    }
+    EVP_PKEY_CTX_free(context);
+    return key;
+}
+
+// The value is stored as given, without checking that it follows DER
+ASN1_TIME *asn1Time(int type, const QByteArray &value)
+{
+    ASN1_STRING *time = ASN1_STRING_type_new(type);
+    ASN1_STRING_set(time, value.constData(), value.size());
+    return time;
+}
+
+QByteArray timeString(int type, const QDateTime &time)
+{
+    return time.toUTC().toString(type == V_ASN1_UTCTIME ? QStringLiteral("yyMMddHHmmss'Z'")
+                                                        : QStringLiteral("yyyyMMddHHmmss'Z'")).toLatin1();
+}
+
+void addNameEntry(X509_NAME *name, const char *field, const QByteArray &value)
+{
+    X509_NAME_add_entry_by_txt(name, field, MBSTRING_UTF8,
+                               reinterpret_cast<const unsigned char *>(value.constData()), value.size(), -1, 0);
+}
+
+QByteArray toPem(X509 *x509)
+{
+    BIO *output = BIO_new(BIO_s_mem());
+    PEM_write_bio_X509(output, x509);
+    char *data = nullptr;
+    const long length = BIO_get_mem_data(output, &data);
+    const QByteArray pem(data, length);
+    BIO_free(output);
+    return pem;
+}
+
+// A self-signed CA certificate in PEM, with the extensions commonly found in the system bundles
+QByteArray createCertificate(EVP_PKEY *key, int serial, int timeType, const QByteArray &notBefore, const QByteArray &notAfter)
+{
+    X509 *x509 = X509_new();
+    X509_set_version(x509, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(x509), serial);
+
+    X509_NAME *name = X509_get_subject_name(x509);
+    addNameEntry(name, "C", "FI");
+    addNameEntry(name, "O", "Synthetic Organization " + QByteArray::number(serial % 97));
+    addNameEntry(name, "OU", "Certification Authorities");
+    addNameEntry(name, "CN", "Synthetic Root CA " + QByteArray::number(serial));
+    X509_set_issuer_name(x509, name);
+
+    ASN1_TIME *time = asn1Time(timeType, notBefore);
+    X509_set1_notBefore(x509, time);
+    ASN1_TIME_free(time);
+    time = asn1Time(timeType, notAfter);
+    X509_set1_notAfter(x509, time);
+    ASN1_TIME_free(time);
+
+    X509_set_pubkey(x509, key);
+
+    const QByteArray alternativeName("DNS:ca" + QByteArray::number(serial) + ".example.com,email:ca@example.com");
+    const char * const extensions[][2] = {
+        { "basicConstraints", "critical,CA:TRUE" },
+        { "keyUsage", "critical,digitalSignature,keyCertSign,cRLSign" },
+        { "extendedKeyUsage", "serverAuth,clientAuth,emailProtection,codeSigning" },
+        { "subjectKeyIdentifier", "hash" },
+        { "authorityKeyIdentifier", "keyid:always" },
+        { "subjectAltName", alternativeName.constData() },
+        { "crlDistributionPoints", "URI:http://crl.example.com/root.crl" },
+        { "authorityInfoAccess", "OCSP;URI:http://ocsp.example.com" },
+    };
+
+    X509V3_CTX context;
+    X509V3_set_ctx_nodb(&context);
+    X509V3_set_ctx(&context, x509, x509, nullptr, nullptr, 0);
+    for (const auto &extension : extensions) {
+        if (X509_EXTENSION *ext = X509V3_EXT_nconf(nullptr, &context, extension[0], extension[1])) {
+            X509_add_ext(x509, ext, -1);
+            X509_EXTENSION_free(ext);
+        }
+    }
+
+    X509_sign(x509, key, EVP_sha256());
+
+    const QByteArray pem(toPem(x509));
+    X509_free(x509);
+    return pem;
+}
+
+// A CA certificate named by the common name, issued by the given certificate or self-signed
+// without one. The names and the key identifiers link it to its issuer.
+X509 *createCaCertificate(EVP_PKEY *key, const QByteArray &commonName, const QDateTime &notBefore,
+                          const QDateTime &notAfter, X509 *issuer = nullptr, EVP_PKEY *issuerKey = nullptr)
+{
+    X509 *x509 = X509_new();
+    X509_set_version(x509, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(x509), qHash(commonName) & 0x7fffffff);
+
+    X509_NAME *name = X509_get_subject_name(x509);
+    addNameEntry(name, "O", "Fixture Organization");
+    addNameEntry(name, "CN", commonName);
+    X509_set_issuer_name(x509, issuer ? X509_get_subject_name(issuer) : name);
+
+    ASN1_TIME *time = ASN1_TIME_set(nullptr, notBefore.toMSecsSinceEpoch() / 1000);
+    X509_set1_notBefore(x509, time);
+    ASN1_TIME_free(time);
+    time = ASN1_TIME_set(nullptr, notAfter.toMSecsSinceEpoch() / 1000);
+    X509_set1_notAfter(x509, time);
+    ASN1_TIME_free(time);
+
+    X509_set_pubkey(x509, key);
+
+    const char * const extensions[][2] = {
+        { "basicConstraints", "critical,CA:TRUE" },
+        { "subjectKeyIdentifier", "hash" },
+        { "authorityKeyIdentifier", "keyid:always" },
+    };
+
+    X509V3_CTX context;
+    X509V3_set_ctx_nodb(&context);
+    X509V3_set_ctx(&context, issuer ? issuer : x509, x509, nullptr, nullptr, 0);
+    for (const auto &extension : extensions) {
+        if (X509_EXTENSION *ext = X509V3_EXT_nconf(nullptr, &context, extension[0], extension[1])) {
+            X509_add_ext(x509, ext, -1);
+            X509_EXTENSION_free(ext);
+        }
+    }
+
+    X509_sign(x509, issuer ? issuerKey : key, EVP_sha256());
+    return x509;
+}
+
+// Resets the peak resident set size of the process
+bool resetPeakMemory()
+{
+    QFile file(QStringLiteral("/proc/self/clear_refs"));
+    return file.open(QIODevice::WriteOnly) && file.write("5") == 1;
+}
+
+// A memory size of the process in bytes, such as the resident set size "VmRSS" or its peak "VmHWM"
+qint64 memoryStatus(const QByteArray &field)
+{
+    QFile file(QStringLiteral("/proc/self/status"));
+    if (file.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> lines(file.readAll().split('\n'));
+        for (const QByteArray &line : lines) {
+            if (line.startsWith(field + ':')) {
+                // "VmHWM:     1234 kB"
+                return line.mid(field.size() + 1).trimmed().split(' ').value(0).toLongLong() * 1024;
+            }
+        }
+    }
+    return -1;
+}
+
+// The regular expression based conversion of the validity times which the parser replaced,
+// kept to compare the results against
+QDateTime regexFromUtcTime(const QString &ts)
+{
+    QDate d;
+    QTime t;
+    int offset = 0;
+
+    // "YYMMDDhhmm[ss](Z|(+|-)hhmm)"
+    const QRegularExpression re("([0-9]{2})([0-9]{2})([0-9]{2})([0-9]{2})([0-9]{2})([0-9]{2})?(Z)?(([+-])([0-9]{2})([0-9]{2}))?");
+    QRegularExpressionMatch match = re.match(ts);
+    if (match.hasMatch()) {
+        int y = match.captured(1).toInt();
+        d = QDate((y < 70 ? 2000 : 1900) + y, match.captured(2).toInt(), match.captured(3).toInt());
+
+        t = QTime(match.captured(4).toInt(), match.captured(5).toInt(), match.captured(6).toInt());
+
+        if (match.lastCapturedIndex() > 7) {
+            offset = match.captured(11).toInt() * 60 + match.captured(10).toInt() * 60*60;
+            if (match.captured(9) == "-") {
+                offset = -offset;
+            }
+        }
+    }
+
+    return QDateTime(d, t, Qt::OffsetFromUTC, offset);
+}
+
+QDateTime regexFromGeneralizedTime(const QString &ts)
+{
+    QDate d;
+    QTime t;
+    int offset = 0;
+
+    // "YYYYMMDDhh[mm[ss[.fff]]](Z|(+|-)hhmm)" <- nested optionals can be treated as appearing sequentially
+    const QRegularExpression re("([0-9]{4})([0-9]{2})([0-9]{2})([0-9]{2})([0-9]{2})?([0-9]{2})?(\\.[0-9]{1,3})?(Z)?(([+-])([0-9]{2})([0-9]{2}))?");
+    QRegularExpressionMatch match = re.match(ts);
+    if (match.hasMatch()) {
+        d = QDate(match.captured(1).toInt(), match.captured(2).toInt(), match.captured(3).toInt());
+
+        double fraction = match.captured(7).toDouble();
+        int ms = (fraction * 1000);
+        t = QTime(match.captured(4).toInt(), match.captured(5).toInt(), match.captured(6).toInt(), ms);
+
+        if (match.lastCapturedIndex() > 8) {
+            offset = match.captured(12).toInt() * 60 + match.captured(11).toInt() * 60*60;
+            if (match.captured(10) == "-") {
+                offset = -offset;
+            }
+        }
+    }
+
+    return QDateTime(d, t, Qt::OffsetFromUTC, offset);
+}
+
+QDateTime regexToDateTime(int type, const QByteArray &value)
+{
+    const QString ts(QString::fromUtf8(value));
+    return type == V_ASN1_GENERALIZEDTIME ? regexFromGeneralizedTime(ts) : regexFromUtcTime(ts);
+}
+
+bool sameTime(const QDateTime &lhs, const QDateTime &rhs)
+{
+    if (!lhs.isValid() || !rhs.isValid()) {
+        return lhs.isValid() == rhs.isValid();
+    }
+    return lhs == rhs && lhs.offsetFromUtc() == rhs.offsetFromUtc();
+}
+
+// The common names of the certificates of the fixture bundle, in the order of the rows
+QStringList fixtureNames()
+{
+    return QStringList() << QStringLiteral("Fixture Expired")
+                         << QStringLiteral("Fixture Future")
+                         << QStringLiteral("Fixture Intermediate")
+                         << QStringLiteral("Fixture Leaf")
+                         << QStringLiteral("Fixture Root");
+}
+
+// The common names of the fetched rows of the model
+QStringList commonNames(const CertificateModel &model)
+{
+    QStringList names;
+    for (int row = 0; row < model.rowCount(); ++row) {
+        names.append(model.data(model.index(row), CertificateModel::CommonNameRole).toString());
+    }
+    return names;
+}
+
+QStringList commonNames(const QList<Certificate> &certificates)
+{
+    QStringList names;
+    for (const Certificate &certificate : certificates) {
+        names.append(certificate.commonName());
+    }
+    return names;
+}
+
+QString cacheDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+            + QStringLiteral("/nemo-systemsettings");
+}
+
+}
+
+class TestCertificateModel : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void readPem_data();
+    void readPem();
+    void getCertificates_data();
+    void getCertificates();
+    void decodeParallel_data();
+    void decodeParallel();
+    void sortCertificates_data();
+    void sortCertificates();
+    void peakMemory_data();
+    void peakMemory();
+    void sharedMemory_data();
+    void sharedMemory();
+    void refresh_data();
+    void refresh();
+    void validityTime_data();
+    void validityTime();
+    void validityTimeFractions();
+    void validityTimeRandom();
+
+    void sharedBundle();
+    void filter_data();
+    void filter();
+    void filterChanges();
+    void issuedBy();
+    void chainFor();
+    void validityLists();
+    void expiringSoonCount();
+    void fetchMore();
+    void fetchMoreFiltered();
+
+private:
+    QByteArray syntheticCertificate(int index) const;
+    QList<QDateTime> decodeNotBefore(const QList<QPair<int, QByteArray> > &times) const;
+    QByteArray bundle(int size) const;
+    QString bundleFile(int size, int copy = 0);
+    void addSizes();
+    void createFixture();
+    QString fixtureFile(const QString &fileName, const QStringList &excluded = QStringList()) const;
+
+    EVP_PKEY *m_rsaKey = nullptr;
+    EVP_PKEY *m_ecKey = nullptr;
+    QList<QByteArray> m_certificates;
+    // The certificates of the fixture by common name
+    QMap<QString, QByteArray> m_fixture;
+    QTemporaryDir m_directory;
+};
+
+void TestCertificateModel::initTestCase()
+{
+    // Keep the certificate cache of the tests apart from that of the user
+    QStandardPaths::setTestModeEnabled(true);
+    QDir(cacheDirectory()).removeRecursively();
+
+    QVERIFY(m_directory.isValid());
+
+    m_rsaKey = generateKey(EVP_PKEY_RSA);
+    m_ecKey = generateKey(EVP_PKEY_EC);
+    QVERIFY(m_rsaKey);
+    QVERIFY(m_ecKey);
+
+    m_certificates.reserve(LargestBundle);
+    for (int i = 0; i < LargestBundle; ++i) {
+        m_certificates.append(syntheticCertificate(i));
+    }
+
+    createFixture();
+    QCOMPARE(m_fixture.keys(), fixtureNames());
+}
+
+void TestCertificateModel::cleanupTestCase()
+{
+    QDir(cacheDirectory()).removeRecursively();
+
+    EVP_PKEY_free(m_rsaKey);
+    EVP_PKEY_free(m_ecKey);
+}
+
+// OpenSSL reading the bundle, without constructing the certificates
+void TestCertificateModel::readPem_data()
+{
+    addSizes();
+}
+
+void TestCertificateModel::readPem()
+{
+    QFETCH(int, size);
+
+    const QByteArray pem(bundle(size));
+    int count = 0;
+    QBENCHMARK {
+        BIO *input = BIO_new_mem_buf(pem.constData(), pem.size());
+        STACK_OF(X509_INFO) *infos = PEM_X509_INFO_read_bio(input, nullptr, nullptr, nullptr);
+        count = sk_X509_INFO_num(infos);
+        sk_X509_INFO_pop_free(infos, X509_INFO_free);
+        BIO_free(input);
+    }
+    QCOMPARE(count, size);
+}
+
+// Reading the bundle and constructing the certificates
+void TestCertificateModel::getCertificates_data()
+{
+    addSizes();
+}
+
+void TestCertificateModel::getCertificates()
+{
+    QFETCH(int, size);
+
+    const QByteArray pem(bundle(size));
+    QList<Certificate> certificates;
+    QBENCHMARK {
+        certificates = CertificateModel::getCertificates(pem);
+    }
+    QCOMPARE(certificates.count(), size);
+}
+
+// Decoding on the calling thread alone against decoding on all the threads of the pool
+void TestCertificateModel::decodeParallel_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<bool>("serial");
+
+    for (int size : BundleSizes) {
+        QTest::newRow(qPrintable(QStringLiteral("%1 serial").arg(size))) << size << true;
+        QTest::newRow(qPrintable(QStringLiteral("%1 parallel").arg(size))) << size << false;
+    }
+}
+
+void TestCertificateModel::decodeParallel()
+{
+    QFETCH(int, size);
+    QFETCH(bool, serial);
+
+    // A pool limited to one thread makes the decoding serial on the calling thread
+    QThreadPool *pool = QThreadPool::globalInstance();
+    const int threads = pool->maxThreadCount();
+    if (serial) {
+        pool->setMaxThreadCount(1);
+    }
+
+    const QByteArray pem(bundle(size));
+    QList<Certificate> certificates;
+    QBENCHMARK {
+        certificates = CertificateModel::getCertificates(pem);
+    }
+    pool->setMaxThreadCount(threads);
+
+    QCOMPARE(certificates.count(), size);
+
+    // The certificates are in the order of the bundle either way
+    for (int i = 0; i < size; ++i) {
+        QCOMPARE(certificates.at(i).commonName(), QStringLiteral("Synthetic Root CA %1").arg(i + 1));
+    }
+}
+
+void TestCertificateModel::sortCertificates_data()
+{
+    addSizes();
+}
+
+void TestCertificateModel::sortCertificates()
+{
+    QFETCH(int, size);
+
+    const QList<Certificate> certificates(CertificateModel::getCertificates(bundle(size)));
+    QBENCHMARK {
+        QList<Certificate> sorted(certificates);
+        std::stable_sort(sorted.begin(), sorted.end(), [](const Certificate &lhs, const Certificate &rhs) {
+            return lhs.sortKey() < rhs.sortKey();
+        });
+    }
+}
+
+// The growth of the peak resident set size while reading the bundle
+void TestCertificateModel::peakMemory_data()
+{
+    addSizes();
+}
+
+void TestCertificateModel::peakMemory()
+{
+    QFETCH(int, size);
+
+    const QByteArray pem(bundle(size));
+    if (!resetPeakMemory()) {
+        QSKIP("The peak resident set size cannot be reset");
+    }
+
+    const qint64 resident = memoryStatus("VmRSS");
+    const QList<Certificate> certificates(CertificateModel::getCertificates(pem));
+    const qint64 peak = memoryStatus("VmHWM");
+
+    QCOMPARE(certificates.count(), size);
+    QVERIFY(resident >= 0 && peak >= 0);
+    QTest::setBenchmarkResult(peak - resident, QTest::BytesAllocated);
+}
+
+// The growth of the resident set size holding the same certificates from several bundle files,
+// either as separate lists or through models, whose bundles share and intern the certificates.
+// Memory freed by the earlier rows may be reused, so compare rows of the same size.
+void TestCertificateModel::sharedMemory_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<bool>("shared");
+
+    for (int size : BundleSizes) {
+        QTest::newRow(qPrintable(QStringLiteral("%1 copies").arg(size))) << size << false;
+        QTest::newRow(qPrintable(QStringLiteral("%1 shared").arg(size))) << size << true;
+    }
+}
+
+void TestCertificateModel::sharedMemory()
+{
+    QFETCH(int, size);
+    QFETCH(bool, shared);
+
+    QStringList paths;
+    for (int copy = 0; copy < BundleCopies; ++copy) {
+        paths.append(bundleFile(size, copy));
+    }
+    QDir(cacheDirectory()).removeRecursively();
+
+    const qint64 resident = memoryStatus("VmRSS");
+
+    QList<QList<Certificate> > copies;
+    QList<CertificateModel *> models;
+    int count = 0;
+    for (const QString &path : paths) {
+        if (shared) {
+            CertificateModel *model = new CertificateModel;
+            model->setBundlePath(path);
+            count += model->totalCount();
+            models.append(model);
+        } else {
+            copies.append(CertificateModel::getCertificates(path));
+            count += copies.last().count();
+        }
+    }
+
+    const qint64 grown = memoryStatus("VmRSS") - resident;
+    qDeleteAll(models);
+
+    QCOMPARE(count, size * BundleCopies);
+    QVERIFY(resident >= 0);
+    QTest::setBenchmarkResult(grown, QTest::BytesAllocated);
+}
+
+// A model showing a bundle file, either parsing it or reading the certificate cache
+void TestCertificateModel::refresh_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<bool>("cached");
+
+    for (int size : BundleSizes) {
+        QTest::newRow(qPrintable(QStringLiteral("%1 parsed").arg(size))) << size << false;
+        QTest::newRow(qPrintable(QStringLiteral("%1 cached").arg(size))) << size << true;
+    }
+}
+
+void TestCertificateModel::refresh()
+{
+    QFETCH(int, size);
+    QFETCH(bool, cached);
+
+    const QString path(bundleFile(size));
+    QDir(cacheDirectory()).removeRecursively();
+    if (cached) {
+        CertificateModel model;
+        model.setBundlePath(path);
+    }
+
+    int count = 0;
+    QBENCHMARK {
+        if (!cached) {
+            QDir(cacheDirectory()).removeRecursively();
+        }
+        CertificateModel model;
+        model.setBundlePath(path);
+        count = model.totalCount();
+    }
+    QCOMPARE(count, size);
+}
+
+// The validity times as read from certificates, against the regular expressions they replaced
+void TestCertificateModel::validityTime_data()
+{
+    QTest::addColumn<int>("type");
+    QTest::addColumn<QByteArray>("value");
+    QTest::addColumn<QDateTime>("expected");
+    // Whether the regular expressions intentionally give a different result
+    QTest::addColumn<bool>("differs");
+
+    const int utc = V_ASN1_UTCTIME;
+    const int generalized = V_ASN1_GENERALIZEDTIME;
+    const QDateTime invalid(QDate(), QTime(), Qt::OffsetFromUTC, 0);
+    const auto time = [](int year, int month, int day, int hour, int minute, int second, int ms = 0, int offset = 0) {
+        return QDateTime(QDate(year, month, day), QTime(hour, minute, second, ms), Qt::OffsetFromUTC, offset);
+    };
+
+    QTest::newRow("utc") << utc << QByteArray("200229235959Z") << time(2020, 2, 29, 23, 59, 59) << false;
+    QTest::newRow("utc without seconds") << utc << QByteArray("2002292359Z") << time(2020, 2, 29, 23, 59, 0) << false;
+    QTest::newRow("utc 1950") << utc << QByteArray("500101000000Z") << time(1950, 1, 1, 0, 0, 0) << false;
+    QTest::newRow("utc 2049") << utc << QByteArray("491231235959Z") << time(2049, 12, 31, 23, 59, 59) << false;
+    QTest::newRow("utc offset") << utc << QByteArray("200101120000+0530") << time(2020, 1, 1, 12, 0, 0, 0, 19800) << false;
+    QTest::newRow("utc negative offset") << utc << QByteArray("2001011200-0130") << time(2020, 1, 1, 12, 0, 0, 0, -5400) << false;
+    QTest::newRow("utc partial offset") << utc << QByteArray("200101120000+01") << time(2020, 1, 1, 12, 0, 0) << false;
+    QTest::newRow("utc too short") << utc << QByteArray("20010112Z") << invalid << false;
+    QTest::newRow("utc empty") << utc << QByteArray() << invalid << false;
+
+    QTest::newRow("generalized") << generalized << QByteArray("20500101000000Z") << time(2050, 1, 1, 0, 0, 0) << false;
+    QTest::newRow("generalized without seconds") << generalized << QByteArray("205001011230Z") << time(2050, 1, 1, 12, 30, 0) << false;
+    QTest::newRow("generalized hour") << generalized << QByteArray("2050010112Z") << time(2050, 1, 1, 12, 0, 0) << false;
+    QTest::newRow("generalized fraction") << generalized << QByteArray("20200101120000.5Z") << time(2020, 1, 1, 12, 0, 0, 500) << false;
+    QTest::newRow("generalized milliseconds") << generalized << QByteArray("20200101120000.029Z") << time(2020, 1, 1, 12, 0, 0, 29) << false;
+    QTest::newRow("generalized long fraction") << generalized << QByteArray("20200101120000.1239Z") << time(2020, 1, 1, 12, 0, 0, 123) << false;
+    QTest::newRow("generalized offset") << generalized << QByteArray("20200101120000.123-0100") << time(2020, 1, 1, 12, 0, 0, 123, -3600) << false;
+    QTest::newRow("generalized invalid month") << generalized << QByteArray("20201301120000Z") << invalid << false;
+    QTest::newRow("generalized invalid hour") << generalized << QByteArray("20200101240000Z") << invalid << false;
+
+    // A fraction is only read after the seconds, the regular expression also took it after
+    // the hour or the minutes
+    QTest::newRow("generalized fraction of minute") << generalized << QByteArray("202001011230.5Z") << time(2020, 1, 1, 12, 30, 0) << true;
+    QTest::newRow("generalized fraction of hour") << generalized << QByteArray("2020010112.5Z") << time(2020, 1, 1, 12, 0, 0) << true;
+    // The time must start at the first character, the regular expression matched anywhere
+    QTest::newRow("utc leading garbage") << utc << QByteArray("X200101120000Z") << invalid << true;
+    QTest::newRow("generalized leading garbage") << generalized << QByteArray(" 20200101120000Z") << invalid << true;
+}
+
+void TestCertificateModel::validityTime()
+{
+    QFETCH(int, type);
+    QFETCH(QByteArray, value);
+    QFETCH(QDateTime, expected);
+    QFETCH(bool, differs);
+
+    const QDateTime parsed(decodeNotBefore(QList<QPair<int, QByteArray> >() << qMakePair(type, value)).value(0));
+    QVERIFY2(sameTime(parsed, expected), qPrintable(QStringLiteral("%1 %2 ms").arg(parsed.toString(Qt::ISODate)).arg(parsed.time().msec())));
+
+    const QDateTime previous(regexToDateTime(type, value));
+    QCOMPARE(sameTime(previous, expected), !differs);
+}
+
+// All fractions of a second of up to three digits. The parser reads the digits exactly, the
+// regular expression scaled a double and truncated it, which gives the same milliseconds for
+// each of them where double arithmetic is IEEE 754 binary64.
+void TestCertificateModel::validityTimeFractions()
+{
+    QList<QPair<int, QByteArray> > times;
+    QList<int> milliseconds;
+    for (int digits = 1, count = 10, scale = 100; digits <= 3; ++digits, count *= 10, scale /= 10) {
+        for (int fraction = 0; fraction < count; ++fraction) {
+            times.append(qMakePair(int(V_ASN1_GENERALIZEDTIME),
+                                   "20200101120000." + QByteArray::number(fraction).rightJustified(digits, '0') + 'Z'));
+            milliseconds.append(fraction * scale);
+        }
+    }
+
+    const QList<QDateTime> parsed(decodeNotBefore(times));
+    QCOMPARE(parsed.count(), times.count());
+
+    int truncated = 0;
+    for (int i = 0; i < times.count(); ++i) {
+        QCOMPARE(parsed.at(i).time().msec(), milliseconds.at(i));
+
+        const int previous = regexToDateTime(times.at(i).first, times.at(i).second).time().msec();
+        if (previous != milliseconds.at(i)) {
+            QCOMPARE(previous, milliseconds.at(i) - 1);
+            ++truncated;
+        }
+    }
+    if (truncated > 0) {
+        qDebug() << "The regular expression conversion truncated" << truncated << "fractions to the millisecond below";
+    }
+}
+
+// Random well formed times of both types give the same result with either conversion
+void TestCertificateModel::validityTimeRandom()
+{
+    std::mt19937 generator(20260101);
+    const auto number = [&generator](int minimum, int maximum, int width) {
+        return QByteArray::number(std::uniform_int_distribution<int>(minimum, maximum)(generator)).rightJustified(width, '0');
+    };
+    const auto chance = [&generator]() {
+        return std::uniform_int_distribution<int>(0, 1)(generator) == 1;
+    };
+
+    QList<QPair<int, QByteArray> > times;
+    for (int i = 0; i < 1000; ++i) {
+        const bool generalized = chance();
+        QByteArray value(generalized ? number(1950, 2200, 4) : number(0, 99, 2));
+        value += number(1, 12, 2) + number(1, 28, 2) + number(0, 23, 2);
+        if (!generalized || chance()) {
+            value += number(0, 59, 2);
+            if (chance()) {
+                value += number(0, 59, 2);
+                if (generalized && chance()) {
+                    value += '.' + number(0, 999, 3).left(std::uniform_int_distribution<int>(1, 3)(generator));
+                }
+            }
+        }
+        if (chance()) {
+            value += 'Z';
+        } else {
+            value += (chance() ? '+' : '-') + number(0, 14, 2) + number(0, 59, 2);
+        }
+        times.append(qMakePair(int(generalized ? V_ASN1_GENERALIZEDTIME : V_ASN1_UTCTIME), value));
+    }
+
+    const QList<QDateTime> parsed(decodeNotBefore(times));
+    QCOMPARE(parsed.count(), times.count());
+
+    for (int i = 0; i < times.count(); ++i) {
+        const QDateTime previous(regexToDateTime(times.at(i).first, times.at(i).second));
+        QVERIFY2(sameTime(parsed.at(i), previous), times.at(i).second.constData());
+    }
+}
+
+// The certificates alternate between RSA and EC keys, and between UTCTime and GeneralizedTime
+// validity, so that each size has all four combinations
+// Models of the same bundle share it, and changes to the file update the rows of all of them
+void TestCertificateModel::sharedBundle()
+{
+    const QString path(fixtureFile(QStringLiteral("shared.pem")));
+
+    CertificateModel first;
+    first.setBundlePath(path);
+    CertificateModel second;
+    second.setBundlePath(path);
+
+    QCOMPARE(first.totalCount(), fixtureNames().count());
+    QCOMPARE(commonNames(first), fixtureNames());
+    QCOMPARE(commonNames(second), fixtureNames());
+
+    // Replacing the bundle without one of the certificates removes only its row
+    QSignalSpy reset(&first, &QAbstractItemModel::modelReset);
+    QSignalSpy removed(&first, &QAbstractItemModel::rowsRemoved);
+    QSignalSpy inserted(&first, &QAbstractItemModel::rowsInserted);
+
+    fixtureFile(QStringLiteral("shared.pem"), QStringList() << QStringLiteral("Fixture Future"));
+    QTRY_COMPARE(first.totalCount(), fixtureNames().count() - 1);
+
+    QStringList expected(fixtureNames());
+    expected.removeOne(QStringLiteral("Fixture Future"));
+    QCOMPARE(commonNames(first), expected);
+    QCOMPARE(commonNames(second), expected);
+    QCOMPARE(reset.count(), 0);
+    QCOMPARE(removed.count(), 1);
+    QCOMPARE(removed.first().at(1).toInt(), 1);
+    QCOMPARE(removed.first().at(2).toInt(), 1);
+    QCOMPARE(inserted.count(), 0);
+
+    // And adding it back inserts the row again
+    fixtureFile(QStringLiteral("shared.pem"));
+    QTRY_COMPARE(first.totalCount(), fixtureNames().count());
+    QCOMPARE(commonNames(first), fixtureNames());
+    QCOMPARE(commonNames(second), fixtureNames());
+    QCOMPARE(reset.count(), 0);
+    QCOMPARE(inserted.count(), 1);
+}
+
+void TestCertificateModel::filter_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QString>("issuer");
+    QTest::addColumn<QString>("keyAlgorithm");
+    QTest::addColumn<QDateTime>("expiresAfter");
+    QTest::addColumn<QDateTime>("expiresBefore");
+    QTest::addColumn<QStringList>("expected");
+
+    const QDateTime now(QDateTime::currentDateTimeUtc());
+    const QString rsa(QString::fromLatin1(OBJ_nid2ln(EVP_PKEY_RSA)));
+    const QStringList none;
+
+    QTest::newRow("none") << QString() << QString() << QString() << QDateTime() << QDateTime()
+                          << fixtureNames();
+    // The issuer names are searched as well
+    QTest::newRow("text") << QStringLiteral("INTER") << QString() << QString() << QDateTime() << QDateTime()
+                          << (QStringList() << QStringLiteral("Fixture Intermediate") << QStringLiteral("Fixture Leaf"));
+    QTest::newRow("text organization") << QStringLiteral("fixture organization") << QString() << QString()
+                                       << QDateTime() << QDateTime() << fixtureNames();
+    QTest::newRow("text no match") << QStringLiteral("nothing") << QString() << QString() << QDateTime() << QDateTime()
+                                   << none;
+    QTest::newRow("issuer") << QString() << QStringLiteral("fixture intermediate") << QString() << QDateTime() << QDateTime()
+                            << (QStringList() << QStringLiteral("Fixture Leaf"));
+    QTest::newRow("issuer self-signed") << QString() << QStringLiteral("FIXTURE ROOT") << QString() << QDateTime() << QDateTime()
+                                        << (QStringList() << QStringLiteral("Fixture Intermediate") << QStringLiteral("Fixture Root"));
+    QTest::newRow("key algorithm") << QString() << QString() << rsa.toUpper() << QDateTime() << QDateTime()
+                                   << (QStringList() << QStringLiteral("Fixture Root"));
+    QTest::newRow("expires before") << QString() << QString() << QString() << QDateTime() << now
+                                    << (QStringList() << QStringLiteral("Fixture Expired"));
+    QTest::newRow("expires after") << QString() << QString() << QString() << now.addYears(2) << QDateTime()
+                                   << (QStringList() << QStringLiteral("Fixture Future") << QStringLiteral("Fixture Root"));
+    QTest::newRow("expiry window") << QString() << QString() << QString() << now << now.addDays(30)
+                                   << (QStringList() << QStringLiteral("Fixture Intermediate"));
+    QTest::newRow("combined") << QStringLiteral("fixture") << QStringLiteral("Fixture Intermediate") << QString()
+                              << now << QDateTime() << (QStringList() << QStringLiteral("Fixture Leaf"));
+}
+
+void TestCertificateModel::filter()
+{
+    QFETCH(QString, text);
+    QFETCH(QString, issuer);
+    QFETCH(QString, keyAlgorithm);
+    QFETCH(QDateTime, expiresAfter);
+    QFETCH(QDateTime, expiresBefore);
+    QFETCH(QStringList, expected);
+
+    const QString path(fixtureFile(QStringLiteral("filter.pem")));
+
+    // The filters apply both when set before the bundle and when changed afterwards
+    CertificateModel before;
+    before.setFilterText(text);
+    before.setFilterIssuer(issuer);
+    before.setFilterKeyAlgorithm(keyAlgorithm);
+    before.setFilterExpiresAfter(expiresAfter);
+    before.setFilterExpiresBefore(expiresBefore);
+    before.setBundlePath(path);
+
+    QCOMPARE(commonNames(before), expected);
+    QCOMPARE(before.totalCount(), expected.count());
+
+    CertificateModel after;
+    after.setBundlePath(path);
+    after.setFilterText(text);
+    after.setFilterIssuer(issuer);
+    after.setFilterKeyAlgorithm(keyAlgorithm);
+    after.setFilterExpiresAfter(expiresAfter);
+    after.setFilterExpiresBefore(expiresBefore);
+
+    QCOMPARE(commonNames(after), expected);
+    QCOMPARE(after.totalCount(), expected.count());
+}
+
+// Narrowing the filter removes and widening it inserts the rows a contiguous run at a time
+void TestCertificateModel::filterChanges()
+{
+    CertificateModel model;
+    model.setBundlePath(fixtureFile(QStringLiteral("filter.pem")));
+    model.setFilterText(QStringLiteral("fixture"));
+    QCOMPARE(commonNames(model), fixtureNames());
+
+    QSignalSpy reset(&model, &QAbstractItemModel::modelReset);
+    QSignalSpy removed(&model, &QAbstractItemModel::rowsRemoved);
+    QSignalSpy inserted(&model, &QAbstractItemModel::rowsInserted);
+
+    model.setFilterText(QStringLiteral("fixture l"));
+    QCOMPARE(commonNames(model), QStringList() << QStringLiteral("Fixture Leaf"));
+    QCOMPARE(removed.count(), 2);
+    QCOMPARE(removed.at(0).at(1).toInt(), 4);
+    QCOMPARE(removed.at(0).at(2).toInt(), 4);
+    QCOMPARE(removed.at(1).at(1).toInt(), 0);
+    QCOMPARE(removed.at(1).at(2).toInt(), 2);
+    QCOMPARE(inserted.count(), 0);
+
+    model.setFilterText(QStringLiteral("fixture"));
+    QCOMPARE(commonNames(model), fixtureNames());
+    QCOMPARE(inserted.count(), 2);
+    QCOMPARE(inserted.at(0).at(1).toInt(), 0);
+    QCOMPARE(inserted.at(0).at(2).toInt(), 2);
+    QCOMPARE(inserted.at(1).at(1).toInt(), 4);
+    QCOMPARE(inserted.at(1).at(2).toInt(), 4);
+    QCOMPARE(model.totalCount(), fixtureNames().count());
+
+    // Changing to an unrelated filter both removes and inserts rows
+    model.setFilterText(QStringLiteral("fixture root"));
+    QCOMPARE(commonNames(model), QStringList() << QStringLiteral("Fixture Intermediate") << QStringLiteral("Fixture Root"));
+    model.setFilterText(QStringLiteral("fixture leaf"));
+    QCOMPARE(commonNames(model), QStringList() << QStringLiteral("Fixture Leaf"));
+    model.setFilterText(QString());
+    QCOMPARE(commonNames(model), fixtureNames());
+
+    QCOMPARE(reset.count(), 0);
+}
+
+void TestCertificateModel::issuedBy()
+{
+    CertificateModel model;
+    model.setBundlePath(fixtureFile(QStringLiteral("chain.pem")));
+
+    const QStringList names(fixtureNames());
+    const int expired = names.indexOf(QStringLiteral("Fixture Expired"));
+    const int intermediate = names.indexOf(QStringLiteral("Fixture Intermediate"));
+    const int leaf = names.indexOf(QStringLiteral("Fixture Leaf"));
+    const int root = names.indexOf(QStringLiteral("Fixture Root"));
+    QCOMPARE(commonNames(model), names);
+
+    QCOMPARE(model.issuedBy(leaf), intermediate);
+    QCOMPARE(model.issuedBy(intermediate), root);
+    // Self-signed certificates end the chain
+    QCOMPARE(model.issuedBy(root), -1);
+    QCOMPARE(model.issuedBy(expired), -1);
+    QCOMPARE(model.issuedBy(-1), -1);
+    QCOMPARE(model.issuedBy(names.count()), -1);
+
+    // An issuer which is filtered out has no row
+    model.setFilterText(QStringLiteral("fixture l"));
+    QCOMPARE(commonNames(model), QStringList() << QStringLiteral("Fixture Leaf"));
+    QCOMPARE(model.issuedBy(0), -1);
+}
+
+void TestCertificateModel::chainFor()
+{
+    CertificateModel model;
+    model.setBundlePath(fixtureFile(QStringLiteral("chain.pem")));
+
+    const QStringList names(fixtureNames());
+    const int intermediate = names.indexOf(QStringLiteral("Fixture Intermediate"));
+    const int leaf = names.indexOf(QStringLiteral("Fixture Leaf"));
+    const int root = names.indexOf(QStringLiteral("Fixture Root"));
+
+    const auto chainNames = [](const QVariantList &chain) {
+        QStringList primaryNames;
+        for (const QVariant &entry : chain) {
+            primaryNames.append(entry.toMap().value(QStringLiteral("primaryName")).toString());
+        }
+        return primaryNames;
+    };
+    const auto chainRows = [](const QVariantList &chain) {
+        QList<int> rows;
+        for (const QVariant &entry : chain) {
+            rows.append(entry.toMap().value(QStringLiteral("row")).toInt());
+        }
+        return rows;
+    };
+
+    const QStringList expected = QStringList() << QStringLiteral("Fixture Leaf")
+                                               << QStringLiteral("Fixture Intermediate")
+                                               << QStringLiteral("Fixture Root");
+
+    QVariantList chain(model.chainFor(leaf));
+    QCOMPARE(chainNames(chain), expected);
+    QCOMPARE(chainRows(chain), QList<int>() << leaf << intermediate << root);
+    QCOMPARE(chain.at(0).toMap().value(QStringLiteral("issuerDisplayName")).toString(),
+             QStringLiteral("Fixture Intermediate"));
+
+    chain = model.chainFor(root);
+    QCOMPARE(chainNames(chain), QStringList() << QStringLiteral("Fixture Root"));
+    QVERIFY(model.chainFor(-1).isEmpty());
+
+    // The chain continues through the issuers which are filtered out
+    model.setFilterText(QStringLiteral("fixture l"));
+    chain = model.chainFor(0);
+    QCOMPARE(chainNames(chain), expected);
+    QCOMPARE(chainRows(chain), QList<int>() << 0 << -1 << -1);
+}
+
+void TestCertificateModel::validityLists()
+{
+    const QString path(fixtureFile(QStringLiteral("validity.pem")));
+
+    QCOMPARE(commonNames(CertificateModel::expiredCertificates(path)),
+             QStringList() << QStringLiteral("Fixture Expired"));
+    QCOMPARE(commonNames(CertificateModel::expiringCertificates(path, 30)),
+             QStringList() << QStringLiteral("Fixture Intermediate"));
+    // Sorted by expiry time
+    QCOMPARE(commonNames(CertificateModel::expiringCertificates(path, 400)),
+             QStringList() << QStringLiteral("Fixture Intermediate") << QStringLiteral("Fixture Leaf"));
+    QCOMPARE(commonNames(CertificateModel::expiringCertificates(path, 5)), QStringList());
+    QCOMPARE(commonNames(CertificateModel::notYetValidCertificates(path)),
+             QStringList() << QStringLiteral("Fixture Future"));
+}
+
+void TestCertificateModel::expiringSoonCount()
+{
+    const QString path(fixtureFile(QStringLiteral("validity.pem")));
+
+    CertificateModel model;
+    model.setExpiringSoonDays(30);
+    model.setBundlePath(path);
+    QCOMPARE(model.expiringSoonCount(), 1);
+
+    QSignalSpy changed(&model, &CertificateModel::expiringSoonCountChanged);
+    model.setExpiringSoonDays(400);
+    QCOMPARE(model.expiringSoonCount(), 2);
+    model.setExpiringSoonDays(5);
+    QCOMPARE(model.expiringSoonCount(), 0);
+    QCOMPARE(changed.count(), 2);
+
+    // The count covers the whole bundle regardless of the filters
+    model.setExpiringSoonDays(30);
+    model.setFilterText(QStringLiteral("fixture root"));
+    QCOMPARE(model.expiringSoonCount(), 1);
+
+    // And it is counted once an asynchronous load has finished
+    CertificateModel asynchronous;
+    asynchronous.setAsynchronous(true);
+    asynchronous.setExpiringSoonDays(30);
+    asynchronous.setBundlePath(fixtureFile(QStringLiteral("validity-async.pem")));
+    QTRY_VERIFY(!asynchronous.loading());
+    QCOMPARE(asynchronous.expiringSoonCount(), 1);
+}
+
+void TestCertificateModel::fetchMore()
+{
+    const int size = 1000;
+
+    CertificateModel model;
+    model.setBundlePath(bundleFile(size));
+
+    QCOMPARE(model.totalCount(), size);
+    QCOMPARE(model.rowCount(), PageSize);
+    QVERIFY(model.canFetchMore(QModelIndex()));
+    QVERIFY(!model.canFetchMore(model.index(0)));
+    QVERIFY(!model.data(model.index(PageSize), CertificateModel::CommonNameRole).isValid());
+
+    QSignalSpy inserted(&model, &QAbstractItemModel::rowsInserted);
+    model.fetchMore(QModelIndex());
+    QCOMPARE(model.rowCount(), 2 * PageSize);
+    QCOMPARE(inserted.count(), 1);
+    QCOMPARE(inserted.first().at(1).toInt(), PageSize);
+    QCOMPARE(inserted.first().at(2).toInt(), 2 * PageSize - 1);
+
+    while (model.canFetchMore(QModelIndex())) {
+        model.fetchMore(QModelIndex());
+    }
+    QCOMPARE(model.rowCount(), size);
+    QCOMPARE(inserted.count(), (size + PageSize - 1) / PageSize - 1);
+
+    model.fetchMore(QModelIndex());
+    QCOMPARE(inserted.count(), (size + PageSize - 1) / PageSize - 1);
+
+    // The pages are in the order of the whole bundle
+    const QStringList names(commonNames(model));
+    QCOMPARE(names.count(), size);
+    for (int row = 1; row < names.count(); ++row) {
+        QVERIFY(names.at(row - 1).toCaseFolded() <= names.at(row).toCaseFolded());
+    }
+}
+
+// Filtering keeps to the fetched rows, so widening the filter fetches no more rows than before
+void TestCertificateModel::fetchMoreFiltered()
+{
+    const int size = 1000;
+
+    CertificateModel model;
+    model.setBundlePath(bundleFile(size));
+
+    // "Synthetic Root CA 1", "... 10" to "... 19", "... 100" to "... 199" and "... 1000"
+    model.setFilterText(QStringLiteral("Synthetic Root CA 1"));
+    QCOMPARE(model.totalCount(), 112);
+    QVERIFY(model.rowCount() <= PageSize);
+
+    model.setFilterText(QString());
+    QCOMPARE(model.totalCount(), size);
+    QCOMPARE(model.rowCount(), PageSize);
+    QVERIFY(model.canFetchMore(QModelIndex()));
+
+    model.fetchMore(QModelIndex());
+    QCOMPARE(model.rowCount(), 2 * PageSize);
+}
+
+QByteArray TestCertificateModel::syntheticCertificate(int index) const
+{
+    const int timeType = (index / 2) % 2 ? V_ASN1_GENERALIZEDTIME : V_ASN1_UTCTIME;
+    EVP_PKEY *key = index % 2 ? m_ecKey : m_rsaKey;
+    const QDateTime notBefore(QDate(2000, 1, 1).addDays(index % 3650), QTime(12, 0), Qt::UTC);
+    // GeneralizedTime is required from 2050 on
+    const QDateTime notAfter(notBefore.addYears(timeType == V_ASN1_UTCTIME ? 20 : 50));
+    return createCertificate(key, index + 1, timeType, timeString(timeType, notBefore), timeString(timeType, notAfter));
+}
+
+// The start of validity of certificates with the given ASN.1 times, as read by the model
+QList<QDateTime> TestCertificateModel::decodeNotBefore(const QList<QPair<int, QByteArray> > &times) const
+{
+    QByteArray pem;
+    for (int i = 0; i < times.count(); ++i) {
+        pem += createCertificate(m_ecKey, i + 1, times.at(i).first, times.at(i).second,
+                                 times.at(i).first == V_ASN1_UTCTIME ? QByteArray("491231235959Z") : QByteArray("22000101000000Z"));
+    }
+
+    QList<QDateTime> parsed;
+    for (const Certificate &certificate : CertificateModel::getCertificates(pem)) {
+        parsed.append(certificate.notValidBefore());
+    }
+    return parsed;
+}
+
+QByteArray TestCertificateModel::bundle(int size) const
+{
+    QByteArray pem;
+    for (int i = 0; i < size; ++i) {
+        pem += m_certificates.at(i);
+    }
+    return pem;
+}
+
+QString TestCertificateModel::bundleFile(int size, int copy)
+{
+    const QString path(m_directory.path() + (copy == 0
+            ? QStringLiteral("/bundle-%1.pem").arg(size)
+            : QStringLiteral("/bundle-%1-%2.pem").arg(size).arg(copy)));
+    if (!QFile::exists(path)) {
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly) || file.write(bundle(size)) < 0) {
+            qWarning() << "Unable to write bundle:" << path;
+        }
+    }
+    return path;
+}
+
+// A root issuing an intermediate certificate which expires soon, which in turn issues
+// a leaf, and two unrelated self-signed certificates, one expired and one not yet valid
+void TestCertificateModel::createFixture()
+{
+    EVP_PKEY *key = generateKey(EVP_PKEY_EC);
+    const QDateTime now(QDateTime::currentDateTimeUtc());
+
+    X509 *root = createCaCertificate(m_rsaKey, "Fixture Root", now.addYears(-1), now.addYears(20));
+    X509 *intermediate = createCaCertificate(m_ecKey, "Fixture Intermediate", now.addYears(-1), now.addDays(10),
+                                             root, m_rsaKey);
+    X509 *leaf = createCaCertificate(key, "Fixture Leaf", now.addDays(-1), now.addYears(1), intermediate, m_ecKey);
+    X509 *expired = createCaCertificate(key, "Fixture Expired", now.addYears(-10), now.addYears(-1));
+    X509 *future = createCaCertificate(key, "Fixture Future", now.addYears(1), now.addYears(5));
+
+    m_fixture.insert(QStringLiteral("Fixture Root"), toPem(root));
+    m_fixture.insert(QStringLiteral("Fixture Intermediate"), toPem(intermediate));
+    m_fixture.insert(QStringLiteral("Fixture Leaf"), toPem(leaf));
+    m_fixture.insert(QStringLiteral("Fixture Expired"), toPem(expired));
+    m_fixture.insert(QStringLiteral("Fixture Future"), toPem(future));
+
+    for (X509 *x509 : { root, intermediate, leaf, expired, future }) {
+        X509_free(x509);
+    }
+    EVP_PKEY_free(key);
+}
+
+// Writes the fixture bundle, replacing any previous file as bundle updates do
+QString TestCertificateModel::fixtureFile(const QString &fileName, const QStringList &excluded) const
+{
+    QByteArray pem;
+    for (auto it = m_fixture.cbegin(); it != m_fixture.cend(); ++it) {
+        if (!excluded.contains(it.key())) {
+            pem += it.value();
+        }
+    }
+
+    const QString path(m_directory.path() + QLatin1Char('/') + fileName);
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(pem) < 0 || !file.commit()) {
+        qWarning() << "Unable to write bundle:" << path;
+    }
+    return path;
+}
+
+void TestCertificateModel::addSizes()
+{
+    QTest::addColumn<int>("size");
+
+    for (int size : BundleSizes) {
+        QTest::newRow(qPrintable(QString::number(size))) << size;
+    }
+}
+
+QTEST_GUILESS_MAIN(TestCertificateModel)
+
+#include "tst_certificatemodel.moc"
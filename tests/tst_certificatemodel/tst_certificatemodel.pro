@@ -0,0 +1,15 @@
+TEMPLATE = app
+TARGET = tst_certificatemodel
+
+QT = core qml testlib
+CONFIG += link_pkgconfig
+PKGCONFIG += libcrypto
+
+INCLUDEPATH += ../../src
+LIBS += -L../../src -lsystemsettings
+
+SOURCES += \
+    tst_certificatemodel.cpp
+
+target.path = /opt/tests/nemo-qml-plugin-systemsettings
+INSTALLS += target